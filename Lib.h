@@ -7,7 +7,36 @@
 #include <random>
 #include <algorithm>
 #include <map>
+#include <vector>
 #include <fstream>
+#include <cstdint>
+#include <unordered_map>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 /// Size type of sudoku.
 typedef int sudoku_size_t;
@@ -223,6 +252,12 @@ bool check_all_1(const std::array<value_t, n> & arr) {
 	return true;
 };
 
+/// Number of threads used if nothing else is specified, at least 1.
+inline unsigned int default_num_threads() {
+	const unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Initialize Sudoku and Convert
 
@@ -338,11 +373,14 @@ enum SolveResultFinal {
 	UniqueSolution, ///< Sudoku has a unique solution.
 	MultipleSolution, ///< Sudoku contains multiple solutions.
 	UnknownSolution, ///< Unknown number of solutions.
+	TimeoutSolution, ///< Search stopped, the \ref SearchBudget was exceeded.
+	CancelledSolution, ///< Search stopped by a \ref CancelToken.
 };
 
 /// String array mapping each \ref SolveResultFinal to an informative string.
 const std::string sol_res_fin_msgs[] = { "Sudoku is invalid, cannot be solved.", "Sudoku has a unique solution.", 
-	"Sudoku has multiple solutions.", "Solutions has not yet been found." };
+	"Sudoku has multiple solutions.", "Solutions has not yet been found.",
+	"Search budget exceeded.", "Search was cancelled." };
 
 /// Printing \ref SolveResultFinal to std::cout.
 inline std::ostream& operator<<(std::ostream & os, const SolveResultFinal & sol_step) {
@@ -930,6 +968,30 @@ SolveStepRes eliminate_possible_numbers_square(sudoku_data_t & s_data) {
 	}
 }
 
+/// Returns \ref Invalid if a number is set twice in a row, col or square.
+template<bool printDebugInfo = printDebugInfodefault>
+SolveStepRes find_duplicate_numbers(const sudoku_data_t & s_data) {
+	std::array<std::uint32_t, side_len> rows = {}, cols = {}, squares = {};
+	for (sudoku_size_t r = 0; r < side_len; ++r) {
+		for (sudoku_size_t c = 0; c < side_len; ++c) {
+			const sudoku_value_t v = s_data[(r * side_len + c) * n_stored_per_cell];
+			if (v == 0) {
+				continue;
+			}
+			const std::uint32_t bit = 1u << (v - 1);
+			const sudoku_size_t sq = (r / square_height) * (side_len / square_width) + c / square_width;
+			if ((rows[r] | cols[c] | squares[sq]) & bit) {
+				if constexpr (printDebugInfo) std::cout << "Number " << v << " set twice.\n";
+				return Invalid;
+			}
+			rows[r] |= bit;
+			cols[c] |= bit;
+			squares[sq] |= bit;
+		}
+	}
+	return ValidnNoChange;
+}
+
 // Updating status uf solving process
 SolveStepRes update(SolveStepRes old_step, SolveStepRes new_step) {
 	if (old_step == Invalid || new_step == Invalid) {
@@ -941,26 +1003,805 @@ SolveStepRes update(SolveStepRes old_step, SolveStepRes new_step) {
 	return old_step;
 }
 
-// Try to solve the sudoku using the previously defined functions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Chain Techniques
+//
+// Eliminations from chains of inferences between candidates, for the
+// sudokus where the techniques above get stuck. They work on candidate
+// bitmasks, see \ref cand_grid_t, and cover XY-wings, XYZ-wings, simple
+// coloring and alternating inference chains (AIC) of bounded length. A
+// strong link between two candidates means at least one of them is true:
+// the two numbers of a cell with only two possible numbers, or the two
+// cells of a unit where a number is possible. A weak link means at most one
+// is true: two numbers of the same cell, or the same number in two cells
+// seeing each other.
+
+/// Candidate bitmask of one cell, bit i set if number i + 1 is possible.
+typedef std::uint16_t cand_mask_t;
+
+/// Mask with all numbers possible.
+constexpr cand_mask_t all_cands = (cand_mask_t)((1 << side_len) - 1);
+
+/// Candidates of all cells, 0 for cells with a number set.
+typedef std::array<cand_mask_t, tot_num_cells> cand_grid_t;
+
+/// Number of possible numbers in the mask.
+inline int count_cands(const cand_mask_t m) {
+#ifdef _MSC_VER
+	return (int)__popcnt16(m);
+#else
+	return __builtin_popcount(m);
+#endif
+}
+
+/// Returns the number encoded in a single-bit mask.
+inline sudoku_value_t mask_to_number(const cand_mask_t m) {
+	sudoku_value_t v = 0;
+	while ((m >> v) > 1) {
+		++v;
+	}
+	return v + 1;
+}
+
+/// Number of cells seen by each cell.
+constexpr sudoku_size_t n_peers = 3 * (side_len - 1) - (square_height - 1) - (square_width - 1);
+
+/// Maximum number of links of the chains of \ref find_aic().
+constexpr int default_aic_links = 7;
+
+/// The units (rows, cols and squares) and the peers of all cells.
+struct SudokuUnits {
+	std::array<std::array<sudoku_size_t, side_len>, 3 * side_len> cells; ///< Cells of the rows, cols and squares.
+	std::array<std::array<sudoku_size_t, 3>, tot_num_cells> of_cell; ///< Row, col and square of each cell.
+	std::array<std::array<sudoku_size_t, n_peers>, tot_num_cells> peers; ///< Cells seen by each cell.
+	std::array<std::array<bool, tot_num_cells>, tot_num_cells> sees; ///< True if two different cells see each other.
+
+	SudokuUnits() {
+		for (auto& s : sees) {
+			s.fill(false);
+		}
+		for (sudoku_size_t i = 0; i < side_len; ++i) {
+			for (sudoku_size_t k = 0; k < side_len; ++k) {
+				cells[i][k] = i * side_len + k;
+				cells[side_len + i][k] = k * side_len + i;
+				const sudoku_size_t sq_row = (i / (side_len / square_width)) * square_height + k / square_width;
+				const sudoku_size_t sq_col = (i % (side_len / square_width)) * square_width + k % square_width;
+				cells[2 * side_len + i][k] = sq_row * side_len + sq_col;
+			}
+		}
+		for (sudoku_size_t u = 0; u < 3 * side_len; ++u) {
+			for (const sudoku_size_t a : cells[u]) {
+				of_cell[a][u / side_len] = u;
+				for (const sudoku_size_t b : cells[u]) {
+					if (a != b) sees[a][b] = true;
+				}
+			}
+		}
+		for (sudoku_size_t a = 0; a < tot_num_cells; ++a) {
+			sudoku_size_t n = 0;
+			for (sudoku_size_t b = 0; b < tot_num_cells; ++b) {
+				if (sees[a][b]) peers[a][n++] = b;
+			}
+			assert(n == n_peers);
+		}
+	}
+};
+
+/// Returns the units, computed once.
+inline const SudokuUnits & get_units() {
+	static const SudokuUnits units;
+	return units;
+}
+
+/// Extracts the candidates of the open cells.
+///
+/// Numbers set in a peer are removed, they may still be marked as possible
+/// if the sudoku was not auto-filled after setting them.
+inline cand_grid_t get_cand_grid(const sudoku_data_t & s_data) {
+	const SudokuUnits & units = get_units();
+	cand_grid_t cands;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const sudoku_size_t data_ind = c * n_stored_per_cell;
+		cand_mask_t m = 0;
+		if (s_data[data_ind] == 0) {
+			for (sudoku_size_t num = 0; num < side_len; ++num) {
+				if (s_data[data_ind + 1 + num] == 2) m |= (cand_mask_t)(1 << num);
+			}
+		}
+		cands[c] = m;
+	}
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const sudoku_value_t v = s_data[c * n_stored_per_cell];
+		if (v == 0) continue;
+		for (const sudoku_size_t p : units.peers[c]) {
+			cands[p] &= (cand_mask_t)~(1 << (v - 1));
+		}
+	}
+	return cands;
+}
+
+/// Marks the numbers that are not in 'cands' as not possible, returns true if anything changed.
+inline bool apply_cand_grid(sudoku_data_t & s_data, const cand_grid_t & cands) {
+	bool changed = false;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const sudoku_size_t data_ind = c * n_stored_per_cell;
+		if (s_data[data_ind] > 0) continue;
+		for (sudoku_size_t num = 0; num < side_len; ++num) {
+			if (s_data[data_ind + 1 + num] == 2 && ((cands[c] >> num) & 1) == 0) {
+				s_data[data_ind + 1 + num] = 1;
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+/// Removes the candidates 'm' from the cell 'c', returns true if any was possible.
+inline bool chain_eliminate(cand_grid_t & cands, const sudoku_size_t c, const cand_mask_t m) {
+	if ((cands[c] & m) == 0) {
+		return false;
+	}
+	cands[c] &= (cand_mask_t)~m;
+	return true;
+}
+
+/// Applies all XY-wings, returns the number of productive instances.
+///
+/// Pivot {x, y} seeing the pincers {x, z} and {y, z}: z is eliminated from
+/// all cells seeing both pincers.
+inline int find_xy_wings(cand_grid_t & cands) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (sudoku_size_t p = 0; p < tot_num_cells; ++p) {
+		if (count_cands(cands[p]) != 2) continue;
+		for (sudoku_size_t i = 0; i < n_peers; ++i) {
+			const sudoku_size_t a = units.peers[p][i];
+			const cand_mask_t common_a = cands[a] & cands[p];
+			if (count_cands(cands[a]) != 2 || count_cands(common_a) != 1) continue;
+			const cand_mask_t z = cands[a] & (cand_mask_t)~cands[p];
+			for (sudoku_size_t j = i + 1; j < n_peers; ++j) {
+				const sudoku_size_t b = units.peers[p][j];
+				const cand_mask_t common_b = cands[b] & cands[p];
+				if (count_cands(cands[b]) != 2 || count_cands(common_b) != 1 || common_b == common_a
+					|| (cands[b] & (cand_mask_t)~cands[p]) != z) continue;
+				bool productive = false;
+				for (const sudoku_size_t c : units.peers[a]) {
+					if (c != b && units.sees[c][b]) productive = chain_eliminate(cands, c, z) || productive;
+				}
+				n_found += productive;
+			}
+		}
+	}
+	return n_found;
+}
+
+/// Applies all XYZ-wings, returns the number of productive instances.
+///
+/// Pivot {x, y, z} seeing the pincers {x, z} and {y, z}: z is eliminated
+/// from all cells seeing the pivot and both pincers.
+inline int find_xyz_wings(cand_grid_t & cands) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (sudoku_size_t p = 0; p < tot_num_cells; ++p) {
+		if (count_cands(cands[p]) != 3) continue;
+		for (sudoku_size_t i = 0; i < n_peers; ++i) {
+			const sudoku_size_t a = units.peers[p][i];
+			if (count_cands(cands[a]) != 2 || (cands[a] & (cand_mask_t)~cands[p]) != 0) continue;
+			for (sudoku_size_t j = i + 1; j < n_peers; ++j) {
+				const sudoku_size_t b = units.peers[p][j];
+				if (count_cands(cands[b]) != 2 || (cands[a] | cands[b]) != cands[p]) continue;
+				const cand_mask_t z = cands[a] & cands[b];
+				bool productive = false;
+				for (const sudoku_size_t c : units.peers[p]) {
+					if (c != a && c != b && units.sees[c][a] && units.sees[c][b]) productive = chain_eliminate(cands, c, z) || productive;
+				}
+				n_found += productive;
+			}
+		}
+	}
+	return n_found;
+}
+
+/// Applies simple coloring to all numbers, returns the number of productive instances.
+///
+/// The cells of each number connected by strong links are colored
+/// alternately. If two cells of the same color see each other, that color is
+/// false (color wrap). Otherwise the number is eliminated from all cells
+/// seeing both colors (color trap).
+inline int find_simple_coloring(cand_grid_t & cands) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (sudoku_size_t d = 0; d < side_len; ++d) {
+		const cand_mask_t bit = (cand_mask_t)(1 << d);
+
+		// Strong links of the number
+		std::array<std::array<sudoku_size_t, 3>, tot_num_cells> links;
+		std::array<int, tot_num_cells> n_links = {};
+		for (const auto& u : units.cells) {
+			sudoku_size_t pos[2];
+			int n_pos = 0;
+			for (const sudoku_size_t c : u) {
+				if ((cands[c] & bit) && n_pos++ < 2) pos[n_pos - 1] = c;
+			}
+			if (n_pos != 2) continue;
+			links[pos[0]][n_links[pos[0]]++] = pos[1];
+			links[pos[1]][n_links[pos[1]]++] = pos[0];
+		}
+
+		// Color each connected component
+		std::array<int, tot_num_cells> color;
+		color.fill(-1);
+		for (sudoku_size_t root = 0; root < tot_num_cells; ++root) {
+			if (n_links[root] == 0 || color[root] >= 0) continue;
+			std::array<sudoku_size_t, tot_num_cells> comp;
+			int n_comp = 0;
+			color[root] = 0;
+			comp[n_comp++] = root;
+			for (int k = 0; k < n_comp; ++k) {
+				const sudoku_size_t c = comp[k];
+				for (int l = 0; l < n_links[c]; ++l) {
+					if (color[links[c][l]] < 0) {
+						color[links[c][l]] = 1 - color[c];
+						comp[n_comp++] = links[c][l];
+					}
+				}
+			}
+			if (n_comp < 3) continue;
+
+			// Color wrap
+			int false_color = -1;
+			for (int k = 0; k < n_comp && false_color < 0; ++k) {
+				for (int l = k + 1; l < n_comp; ++l) {
+					if (color[comp[k]] == color[comp[l]] && units.sees[comp[k]][comp[l]]) {
+						false_color = color[comp[k]];
+						break;
+					}
+				}
+			}
+			bool productive = false;
+			if (false_color >= 0) {
+				for (int k = 0; k < n_comp; ++k) {
+					if (color[comp[k]] == false_color) productive = chain_eliminate(cands, comp[k], bit) || productive;
+				}
+				n_found += productive;
+				continue;
+			}
+
+			// Color trap
+			for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+				if ((cands[c] & bit) == 0) continue;
+				bool sees_color[2] = { false, false };
+				for (int k = 0; k < n_comp; ++k) {
+					if (comp[k] != c && units.sees[c][comp[k]]) sees_color[color[comp[k]]] = true;
+				}
+				bool in_comp = false;
+				for (int k = 0; k < n_comp; ++k) {
+					in_comp = in_comp || comp[k] == c;
+				}
+				if (!in_comp && sees_color[0] && sees_color[1]) productive = chain_eliminate(cands, c, bit) || productive;
+			}
+			n_found += productive;
+		}
+	}
+	return n_found;
+}
+
+/// Applies the first productive alternating inference chain, returns 1 if one was found.
+///
+/// Starting from every candidate A assumed false, the consequences along
+/// strong (false to true) and weak (true to false) links are searched
+/// breadth first, up to 'max_links' links. If a candidate B is reached as
+/// true, A or B is true and all candidates weakly linked to both are
+/// eliminated. If A itself or both values of a candidate are reached, A is
+/// true.
+inline int find_aic(cand_grid_t & cands, const int max_links = default_aic_links) {
+	constexpr sudoku_size_t n_nodes = tot_num_cells * side_len;
+	const SudokuUnits & units = get_units();
+
+	// Strong links, node = cell * side_len + number
+	std::array<std::array<std::uint16_t, 4>, n_nodes> strong;
+	std::array<std::uint8_t, n_nodes> n_strong = {};
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (count_cands(cands[c]) != 2) continue;
+		sudoku_size_t nums[2];
+		int n = 0;
+		for (sudoku_size_t d = 0; d < side_len; ++d) {
+			if ((cands[c] >> d) & 1) nums[n++] = d;
+		}
+		strong[c * side_len + nums[0]][n_strong[c * side_len + nums[0]]++] = (std::uint16_t)(c * side_len + nums[1]);
+		strong[c * side_len + nums[1]][n_strong[c * side_len + nums[1]]++] = (std::uint16_t)(c * side_len + nums[0]);
+	}
+	for (sudoku_size_t d = 0; d < side_len; ++d) {
+		for (const auto& u : units.cells) {
+			sudoku_size_t pos[2];
+			int n_pos = 0;
+			for (const sudoku_size_t c : u) {
+				if (((cands[c] >> d) & 1) && n_pos++ < 2) pos[n_pos - 1] = c;
+			}
+			if (n_pos != 2) continue;
+			const sudoku_size_t a = pos[0] * side_len + d, b = pos[1] * side_len + d;
+			strong[a][n_strong[a]++] = (std::uint16_t)b;
+			strong[b][n_strong[b]++] = (std::uint16_t)a;
+		}
+	}
+
+	// Breadth first search over (node, value) states, state = 2 * node + value
+	// The distances are only valid if the stamp is that of the current start
+	std::array<int, 2 * n_nodes> dist;
+	std::array<sudoku_size_t, 2 * n_nodes> stamp;
+	stamp.fill(-1);
+	std::array<sudoku_size_t, 2 * n_nodes> queue;
+	for (sudoku_size_t start = 0; start < n_nodes; ++start) {
+		if (n_strong[start] == 0) continue;
+		auto reached = [&](const sudoku_size_t state) {
+			return stamp[state] == start;
+		};
+		int q_beg = 0, q_end = 0;
+		dist[2 * start] = 0;
+		stamp[2 * start] = start;
+		queue[q_end++] = 2 * start;
+		bool contradiction = false;
+		while (q_beg < q_end && !contradiction) {
+			const sudoku_size_t state = queue[q_beg++];
+			if (dist[state] == max_links) continue;
+			const sudoku_size_t node = state / 2;
+			auto visit = [&](const sudoku_size_t next) {
+				if (reached(next)) return;
+				dist[next] = dist[state] + 1;
+				stamp[next] = start;
+				queue[q_end++] = next;
+				contradiction = contradiction || reached(next ^ 1) || next == 2 * start + 1;
+			};
+			if ((state & 1) == 0) {
+				for (int l = 0; l < n_strong[node]; ++l) {
+					visit(2 * strong[node][l] + 1);
+				}
+			}
+			else {
+				const sudoku_size_t c = node / side_len, d = node % side_len;
+				for (sudoku_size_t e = 0; e < side_len; ++e) {
+					if (e != d && ((cands[c] >> e) & 1)) visit(2 * (c * side_len + e));
+				}
+				for (const sudoku_size_t p : units.peers[c]) {
+					if ((cands[p] >> d) & 1) visit(2 * (p * side_len + d));
+				}
+			}
+		}
+
+		const sudoku_size_t ca = start / side_len, da = start % side_len;
+		const cand_mask_t bit_a = (cand_mask_t)(1 << da);
+		if (contradiction) {
+			if (chain_eliminate(cands, ca, (cand_mask_t)~bit_a)) return 1;
+			continue;
+		}
+
+		// Candidates weakly linked to A and B
+		bool productive = false;
+		for (sudoku_size_t b = 0; b < n_nodes; ++b) {
+			if (b == start || !reached(2 * b + 1)) continue;
+			const sudoku_size_t cb = b / side_len, db = b % side_len;
+			const cand_mask_t bit_b = (cand_mask_t)(1 << db);
+			if (db == da) {
+				for (const sudoku_size_t c : units.peers[ca]) {
+					if (c != cb && units.sees[c][cb]) productive = chain_eliminate(cands, c, bit_a) || productive;
+				}
+			}
+			else if (cb == ca) {
+				productive = chain_eliminate(cands, ca, (cand_mask_t)~(bit_a | bit_b)) || productive;
+			}
+			else if (units.sees[ca][cb]) {
+				productive = chain_eliminate(cands, ca, bit_b) || productive;
+				productive = chain_eliminate(cands, cb, bit_a) || productive;
+			}
+		}
+		if (productive) return 1;
+	}
+	return 0;
+}
+
+/// Chain techniques, in the order they are tried.
+enum ChainTechnique {
+	ChainXYWing, ///< \ref find_xy_wings().
+	ChainXYZWing, ///< \ref find_xyz_wings().
+	ChainSimpleColoring, ///< \ref find_simple_coloring().
+	ChainAic, ///< \ref find_aic().
+};
+
+/// Applies all instances of the chain technique 'tech', returns their number.
+inline int apply_chain_technique(cand_grid_t & cands, const ChainTechnique tech, const int max_aic_links = default_aic_links) {
+	switch (tech) {
+	case ChainXYWing: return find_xy_wings(cands);
+	case ChainXYZWing: return find_xyz_wings(cands);
+	case ChainSimpleColoring: return find_simple_coloring(cands);
+	case ChainAic: return find_aic(cands, max_aic_links);
+	}
+	return 0;
+}
+
+/// Looks for possible numbers that can be eliminated by chains.
+///
+/// Stops at the first chain technique that eliminates something.
 template<bool printDebugInfo = printDebugInfodefault>
-SolveStepRes try_solving(sudoku_data_t & s_data) {
+SolveStepRes find_chain_eliminations(sudoku_data_t & s_data, const int max_aic_links = default_aic_links) {
+	cand_grid_t cands = get_cand_grid(s_data);
+	for (int tech = ChainXYWing; tech <= ChainAic; ++tech) {
+		if (apply_chain_technique(cands, (ChainTechnique)tech, max_aic_links) == 0) continue;
+		apply_cand_grid(s_data, cands);
+		if constexpr (printDebugInfo) std::cout << "Eliminated possible numbers by chains.\n";
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			if (s_data[c * n_stored_per_cell] == 0 && cands[c] == 0) {
+				return Invalid;
+			}
+		}
+		return ValidNewFound;
+	}
+	if constexpr (printDebugInfo) std::cout << "Sudoku checked for chains.\n";
+	return ValidnNoChange;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Technique Instrumentation
+//
+// If the template flag 'instrumentTechniques' of \ref try_solving() is set,
+// every technique call is timed and its placements and eliminations are
+// counted in thread-local counters. \ref get_technique_report() merges the
+// counters of all threads. Without the flag nothing is recorded.
+
+constexpr bool instrumentTechniquesDefault = false;
+
+/// Number of instrumented techniques, the six of \ref try_solving(), \ref auto_fill() and the chains.
+constexpr int n_instr_techniques = 8;
+
+/// Names of the instrumented techniques, the first six in the order of the bits of \ref PropagationTechnique.
+const std::string instr_technique_names[n_instr_techniques] = { "find_unique_in_rcs", "find_unique_in_square",
+	"find_single_number_cell", "eliminate_possible_numbers_row", "eliminate_possible_numbers_col",
+	"eliminate_possible_numbers_square", "auto_fill", "find_chain_eliminations" };
+
+/// Reads the time stamp counter, or nanoseconds where there is none.
+inline std::uint64_t read_cycle_counter() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// Counters of one technique.
+struct TechniqueCounters {
+	std::uint64_t calls = 0; ///< Number of calls.
+	std::uint64_t cycles = 0; ///< Cycles spent in the calls.
+	std::uint64_t placements = 0; ///< Numbers set.
+	std::uint64_t eliminations = 0; ///< Possible numbers removed.
+};
+
+/// Counters of all techniques.
+typedef std::array<TechniqueCounters, n_instr_techniques> technique_report_t;
+
+/// Counters of one thread.
+///
+/// Only the owning thread writes, the others may read concurrently, hence
+/// the relaxed atomics. They compile to plain loads and stores.
+struct ThreadTechniqueCounters {
+	std::array<std::array<std::atomic<std::uint64_t>, 4>, n_instr_techniques> c;
+
+	ThreadTechniqueCounters();
+	~ThreadTechniqueCounters();
+
+	void add(const int tech, const std::uint64_t cycles, const std::uint64_t placements, const std::uint64_t elims) {
+		const std::uint64_t vals[4] = { 1, cycles, placements, elims };
+		for (int k = 0; k < 4; ++k) {
+			c[tech][k].store(c[tech][k].load(std::memory_order_relaxed) + vals[k], std::memory_order_relaxed);
+		}
+	}
+
+	void add_to(technique_report_t & rep) const {
+		for (int t = 0; t < n_instr_techniques; ++t) {
+			rep[t].calls += c[t][0].load(std::memory_order_relaxed);
+			rep[t].cycles += c[t][1].load(std::memory_order_relaxed);
+			rep[t].placements += c[t][2].load(std::memory_order_relaxed);
+			rep[t].eliminations += c[t][3].load(std::memory_order_relaxed);
+		}
+	}
+
+	void reset() {
+		for (auto& tc : c) {
+			for (auto& v : tc) {
+				v.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+/// Registry of the counters of all threads.
+struct TechniqueRegistry {
+	std::mutex mtx;
+	std::vector<const ThreadTechniqueCounters *> live; ///< Counters of running threads.
+	technique_report_t retired = technique_report_t(); ///< Sum of the counters of finished threads.
+};
+
+inline TechniqueRegistry & get_technique_registry() {
+	static TechniqueRegistry reg;
+	return reg;
+}
+
+inline ThreadTechniqueCounters::ThreadTechniqueCounters() {
+	reset();
+	TechniqueRegistry & reg = get_technique_registry();
+	std::lock_guard<std::mutex> lock(reg.mtx);
+	reg.live.push_back(this);
+}
+
+inline ThreadTechniqueCounters::~ThreadTechniqueCounters() {
+	TechniqueRegistry & reg = get_technique_registry();
+	std::lock_guard<std::mutex> lock(reg.mtx);
+	add_to(reg.retired);
+	reg.live.erase(std::find(reg.live.begin(), reg.live.end(), this));
+}
+
+/// The counters of the calling thread.
+inline ThreadTechniqueCounters & local_technique_counters() {
+	thread_local ThreadTechniqueCounters counters;
+	return counters;
+}
+
+/// Merges the counters of all threads.
+inline technique_report_t get_technique_report() {
+	TechniqueRegistry & reg = get_technique_registry();
+	std::lock_guard<std::mutex> lock(reg.mtx);
+	technique_report_t rep = reg.retired;
+	for (const auto * tc : reg.live) {
+		tc->add_to(rep);
+	}
+	return rep;
+}
+
+/// Sets the counters of all threads to zero.
+///
+/// Should not be called while instrumented solvers are running.
+inline void reset_technique_report() {
+	TechniqueRegistry & reg = get_technique_registry();
+	std::lock_guard<std::mutex> lock(reg.mtx);
+	reg.retired = technique_report_t();
+	for (const auto * tc : reg.live) {
+		const_cast<ThreadTechniqueCounters *>(tc)->reset();
+	}
+}
+
+/// Prints the report as a table.
+inline std::ostream& operator<<(std::ostream & os, const technique_report_t & rep) {
+	os << "Technique, calls, cycles, cycles/call, placements, eliminations\n";
+	for (int t = 0; t < n_instr_techniques; ++t) {
+		const TechniqueCounters & tc = rep[t];
+		os << instr_technique_names[t] << ", " << tc.calls << ", " << tc.cycles << ", "
+			<< (tc.calls > 0 ? tc.cycles / tc.calls : 0) << ", " << tc.placements << ", " << tc.eliminations << "\n";
+	}
+	return os;
+}
+
+/// Number of set cells and of possible-flags of all cells.
+inline std::pair<std::uint64_t, std::uint64_t> count_set_and_possible(const sudoku_data_t & s_data) {
+	std::uint64_t n_set = 0;
+	std::uint64_t n_poss = 0;
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		const sudoku_size_t data_ind = i * n_stored_per_cell;
+		n_set += s_data[data_ind] > 0;
+		for (sudoku_size_t num = 0; num < side_len; ++num) {
+			n_poss += s_data[data_ind + 1 + num] == 2;
+		}
+	}
+	return std::make_pair(n_set, n_poss);
+}
+
+/// Runs the technique 'f', records it as 'tech' if instrumented.
+template<bool instrumentTechniques, typename Func>
+SolveStepRes run_technique(const int tech, sudoku_data_t & s_data, Func && f) {
+	if constexpr (!instrumentTechniques) {
+		return f();
+	}
+	else {
+		const auto before = count_set_and_possible(s_data);
+		const std::uint64_t t_start = read_cycle_counter();
+		const SolveStepRes res = f();
+		const std::uint64_t cycles = read_cycle_counter() - t_start;
+		const auto after = count_set_and_possible(s_data);
+		const std::uint64_t placed = after.first - before.first;
+		const std::uint64_t elims = before.second > after.second ? before.second - after.second : 0;
+		local_technique_counters().add(tech, cycles, placed, elims);
+		return res;
+	}
+}
+
+/// Number of propagation rounds of \ref try_solving() on the calling thread.
+inline std::uint64_t & propagation_rounds() {
+	thread_local std::uint64_t n_rounds = 0;
+	return n_rounds;
+}
+
+/// Techniques of \ref try_solving(), combined as bitmask.
+enum PropagationTechnique {
+	TechUniqueInRcs = 1 << 0, ///< \ref find_unique_in_rcs().
+	TechUniqueInSquare = 1 << 1, ///< \ref find_unique_in_square().
+	TechSingleNumberCell = 1 << 2, ///< \ref find_single_number_cell().
+	TechEliminateRow = 1 << 3, ///< \ref eliminate_possible_numbers_row().
+	TechEliminateCol = 1 << 4, ///< \ref eliminate_possible_numbers_col().
+	TechEliminateSquare = 1 << 5, ///< \ref eliminate_possible_numbers_square().
+	TechChains = 1 << 6, ///< \ref find_chain_eliminations(), only if the others found nothing.
+};
+
+/// Bitmask of \ref PropagationTechnique.
+typedef std::uint32_t technique_mask_t;
+
+/// All techniques, as used by \ref try_solving().
+constexpr technique_mask_t all_techniques = (1 << 6) - 1;
+
+/// All techniques including the chains.
+constexpr technique_mask_t chain_techniques = all_techniques | TechChains;
+
+/// Only the naked and hidden singles.
+constexpr technique_mask_t single_techniques = TechUniqueInRcs | TechUniqueInSquare | TechSingleNumberCell;
+
+/// Propagation done at one node of the search.
+struct PropagationStage {
+	technique_mask_t techniques = all_techniques; ///< Techniques to run.
+	int max_rounds = 0; ///< Maximum number of rounds, 0: until nothing changes.
+};
+
+/// Maximum number of stages of a \ref PropagationProfile.
+constexpr int max_profile_stages = 8;
+
+/// Propagation per search depth.
+///
+/// Stage d is used at depth d, the last stage at all deeper nodes.
+struct PropagationProfile {
+	std::array<PropagationStage, max_profile_stages> stages;
+	int n_stages = 1;
+
+	/// Returns the stage used at 'depth'.
+	const PropagationStage & at(const int depth) const {
+		return stages[std::min(depth, n_stages - 1)];
+	}
+
+	/// All techniques until nothing changes at every depth, like \ref try_solving().
+	static PropagationProfile full() {
+		return PropagationProfile();
+	}
+
+	/// Uses 'top' above depth 'k' and 'below' from depth 'k' on.
+	static PropagationProfile split(const int k, const PropagationStage & top, const PropagationStage & below) {
+		assert(k >= 0 && k < max_profile_stages);
+		PropagationProfile p;
+		for (int d = 0; d < k; ++d) {
+			p.stages[d] = top;
+		}
+		p.stages[k] = below;
+		p.n_stages = k + 1;
+		return p;
+	}
+
+	/// Full propagation above depth 'k', only singles from depth 'k' on.
+	static PropagationProfile singles_below(const int k) {
+		PropagationStage below;
+		below.techniques = single_techniques;
+		return split(k, PropagationStage(), below);
+	}
+};
+
+/// Prints the profile as 'techniques/max_rounds' per stage.
+inline std::ostream& operator<<(std::ostream & os, const PropagationProfile & p) {
+	for (int d = 0; d < p.n_stages; ++d) {
+		os << (d > 0 ? " " : "") << "0x" << std::hex << p.stages[d].techniques << std::dec
+			<< "/" << p.stages[d].max_rounds;
+	}
+	return os;
+}
+
+// Try to solve the sudoku using the techniques and round limit of 'stage'
+template<bool printDebugInfo = printDebugInfodefault, bool instrumentTechniques = instrumentTechniquesDefault>
+SolveStepRes try_solving(sudoku_data_t & s_data, const PropagationStage & stage) {
 
 	SolveStepRes found_something = ValidNewFound;
+	const technique_mask_t tech = stage.techniques;
+	std::uint64_t & n_rounds = propagation_rounds();
 
-	while (found_something == ValidNewFound) {
+	for (int round = 0; found_something == ValidNewFound && (stage.max_rounds == 0 || round < stage.max_rounds); ++round) {
+		++n_rounds;
 		found_something = ValidnNoChange;
-		found_something = update(found_something, find_unique_in_rcs<printDebugInfo>(s_data));
-		found_something = update(found_something, find_unique_in_square<printDebugInfo>(s_data));
-		found_something = update(found_something, find_single_number_cell<printDebugInfo>(s_data));
-		found_something = update(found_something, eliminate_possible_numbers_row<printDebugInfo>(s_data));
-		found_something = update(found_something, eliminate_possible_numbers_col<printDebugInfo>(s_data));
-		found_something = update(found_something, eliminate_possible_numbers_square<printDebugInfo>(s_data));
-		
-		auto_fill<printDebugInfo>(s_data, false);
+		if (tech & TechUniqueInRcs) found_something = update(found_something, run_technique<instrumentTechniques>(0, s_data,
+			[&]() { return find_unique_in_rcs<printDebugInfo>(s_data); }));
+		if (tech & TechUniqueInSquare) found_something = update(found_something, run_technique<instrumentTechniques>(1, s_data,
+			[&]() { return find_unique_in_square<printDebugInfo>(s_data); }));
+		if (tech & TechSingleNumberCell) found_something = update(found_something, run_technique<instrumentTechniques>(2, s_data,
+			[&]() { return find_single_number_cell<printDebugInfo>(s_data); }));
+		if (tech & TechEliminateRow) found_something = update(found_something, run_technique<instrumentTechniques>(3, s_data,
+			[&]() { return eliminate_possible_numbers_row<printDebugInfo>(s_data); }));
+		if (tech & TechEliminateCol) found_something = update(found_something, run_technique<instrumentTechniques>(4, s_data,
+			[&]() { return eliminate_possible_numbers_col<printDebugInfo>(s_data); }));
+		if (tech & TechEliminateSquare) found_something = update(found_something, run_technique<instrumentTechniques>(5, s_data,
+			[&]() { return eliminate_possible_numbers_square<printDebugInfo>(s_data); }));
+		if ((tech & TechChains) && found_something == ValidnNoChange) found_something = update(found_something,
+			run_technique<instrumentTechniques>(7, s_data, [&]() { return find_chain_eliminations<printDebugInfo>(s_data); }));
+
+		run_technique<instrumentTechniques>(6, s_data, [&]() { auto_fill<printDebugInfo>(s_data, false); return ValidnNoChange; });
+	}
+
+	// The unit checks only cover the final state if they ran in a round without changes
+	constexpr technique_mask_t unit_checks = TechUniqueInRcs | TechUniqueInSquare;
+	if (found_something == ValidNewFound || (found_something == ValidnNoChange && (tech & unit_checks) != unit_checks)) {
+		if (find_duplicate_numbers<printDebugInfo>(s_data) == Invalid) {
+			return Invalid;
+		}
 	}
 	return found_something;
 }
 
+// Try to solve the sudoku using all techniques until nothing changes
+template<bool printDebugInfo = printDebugInfodefault, bool instrumentTechniques = instrumentTechniquesDefault>
+SolveStepRes try_solving(sudoku_data_t & s_data) {
+	return try_solving<printDebugInfo, instrumentTechniques>(s_data, PropagationStage());
+}
+
+/// Profile used by the searches on the calling thread, nullptr for \ref PropagationProfile::full().
+inline const PropagationProfile *& active_profile() {
+	thread_local const PropagationProfile * profile = nullptr;
+	return profile;
+}
+
+/// Depth of the innermost search node on the calling thread.
+inline int & active_search_depth() {
+	thread_local int depth = 0;
+	return depth;
+}
+
+/// Makes the searches on the calling thread use 'profile' while it exists.
+///
+/// The searches take the stage of their depth from the active profile, see
+/// \ref propagate_node(). Scopes can be nested, nullptr restores the full
+/// propagation.
+class ProfileScope {
+
+public:
+	explicit ProfileScope(const PropagationProfile * profile) : prev(active_profile()), prev_depth(active_search_depth()) {
+		active_profile() = profile;
+		active_search_depth() = 0;
+	}
+
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope & operator=(const ProfileScope &) = delete;
+
+	~ProfileScope() {
+		active_profile() = prev;
+		active_search_depth() = prev_depth;
+	}
+
+private:
+	const PropagationProfile * prev;
+	const int prev_depth;
+};
+
+/// A search node, tracks the depth on the calling thread while it exists.
+class SearchDepthScope {
+
+public:
+	SearchDepthScope() : depth(active_search_depth()++) {}
+
+	SearchDepthScope(const SearchDepthScope &) = delete;
+	SearchDepthScope & operator=(const SearchDepthScope &) = delete;
+
+	~SearchDepthScope() {
+		--active_search_depth();
+	}
+
+	const int depth; ///< Depth of the node, 0 at the root.
+};
+
+// Propagate at the search node 'node' with the stage of the active profile
+template<bool printDebugInfo = printDebugInfodefault>
+SolveStepRes propagate_node(sudoku_data_t & s_data, const SearchDepthScope & node) {
+	const PropagationProfile * profile = active_profile();
+	return profile ? try_solving<printDebugInfo>(s_data, profile->at(node.depth)) : try_solving<printDebugInfo>(s_data);
+}
+
 // Check if sudoku is solved, raises an exception if it is invalid
 template<sudoku_size_t square_height, sudoku_size_t square_width>
 bool solved(sudoku_data_t & s_data) {
@@ -1004,23 +1845,540 @@ bool solved(sudoku_data_t & s_data) {
 
 constexpr bool printRecDebInfo = false;
 
-// Find the cell with the least numbers possible
-template<bool printDebugInfo = printDebugInfodefault>
-sudoku_size_t find_least_uncertain_cell(sudoku_data_t & s_data) {
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Search Tracing
+//
+// A \ref SearchTracer records the nodes, guesses, propagation spans and
+// contradictions of the searches running on its thread into a ring buffer
+// that is allocated once. It is activated per search with a
+// \ref TraceScope, which only activates every n-th search if sampling is
+// used. Without active tracer the searches only check a thread-local pointer
+// per node. The recording can be saved in the Chrome trace format, which is
+// also read by Perfetto.
+
+/// Kinds of trace events.
+enum TraceEventType : std::uint8_t {
+	TraceNodeEnter, ///< A search node is entered.
+	TraceNodeExit, ///< A search node is left.
+	TracePropagateBegin, ///< Propagation with \ref try_solving() starts.
+	TracePropagateEnd, ///< Propagation ends.
+	TraceGuess, ///< A number is guessed for a cell.
+	TraceContradiction, ///< Propagation found the sudoku invalid.
+	TraceSolution, ///< A solution was found.
+};
 
-	sudoku_size_t min_poss_nums = side_len;
-	sudoku_size_t min_data_ind = 0;
+/// One recorded event.
+struct TraceEvent {
+	std::uint64_t t_ns; ///< Time since the creation of the tracer.
+	TraceEventType type; ///< Kind of event.
+	std::int8_t digit; ///< Guessed number (\ref TraceGuess only).
+	std::int16_t cell; ///< Cell index (\ref TraceGuess only).
+	std::int32_t depth; ///< Recursion depth of the node.
+};
 
-	// Iterate over all rows 
-	for (sudoku_size_t row_num = 0; row_num < side_len; ++row_num) {
+/// Records the search events of one thread into a ring buffer.
+class SearchTracer {
 
-		// Iterate over all cols 
-		for (sudoku_size_t col_num = 0; col_num < side_len; ++col_num) {
+public:
+	/// Keeps the last 'capacity' events and traces every 'sample_every'-th search.
+	explicit SearchTracer(const std::size_t capacity = 1 << 16, const std::uint32_t sample_every = 1,
+		const std::uint32_t thread_id = 0)
+		: events(std::max<std::size_t>(1, capacity)), sample_every(std::max(1u, sample_every)),
+		thread_id(thread_id), t_start(std::chrono::steady_clock::now()) {};
+
+	/// Records an event, only allocation free operations.
+	void record(const TraceEventType type, const sudoku_size_t cell = -1, const sudoku_value_t digit = 0) {
+		if (type == TraceNodeExit) {
+			--depth;
+		}
+		TraceEvent & e = events[n_recorded % events.size()];
+		e.t_ns = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - t_start).count();
+		e.type = type;
+		e.digit = (std::int8_t)digit;
+		e.cell = (std::int16_t)cell;
+		e.depth = type == TraceNodeEnter || type == TraceNodeExit ? depth : depth - 1;
+		++n_recorded;
+		if (type == TraceNodeEnter) {
+			++depth;
+		}
+	}
 
-			const sudoku_size_t cell_ind = row_num + col_num * side_len;
-			const sudoku_size_t data_ind = cell_ind * n_stored_per_cell;
+	/// Decides if the next search is traced.
+	bool next_sampled() {
+		return n_searches++ % sample_every == 0;
+	}
 
-			if (s_data[data_ind] > 0) continue;
+	/// Number of events in the buffer.
+	std::size_t size() const {
+		return (std::size_t)std::min<std::uint64_t>(n_recorded, events.size());
+	}
+
+	/// Number of events that were overwritten.
+	std::uint64_t num_dropped() const {
+		return n_recorded - size();
+	}
+
+	/// Removes all events.
+	void clear() {
+		n_recorded = 0;
+		depth = 0;
+	}
+
+	/// Writes the events in the Chrome trace event format.
+	void write_chrome_trace(std::ostream & os) const {
+		static const char * names[] = { "node", "node", "propagate", "propagate", "guess", "contradiction", "solution" };
+		static const char phases[] = { 'B', 'E', 'B', 'E', 'i', 'i', 'i' };
+		os << "{\"traceEvents\":[";
+		const std::uint64_t first = n_recorded - size();
+		for (std::uint64_t k = first; k < n_recorded; ++k) {
+			const TraceEvent & e = events[k % events.size()];
+			os << (k > first ? ",\n" : "\n") << "{\"name\":\"" << names[e.type] << "\",\"ph\":\"" << phases[e.type]
+				<< "\",\"ts\":" << e.t_ns / 1000 << "." << (e.t_ns % 1000) / 100 << (e.t_ns % 100) / 10 << e.t_ns % 10
+				<< ",\"pid\":0,\"tid\":" << thread_id;
+			if (phases[e.type] == 'i') {
+				os << ",\"s\":\"t\"";
+			}
+			os << ",\"args\":{\"depth\":" << e.depth;
+			if (e.type == TraceGuess) {
+				os << ",\"cell\":" << e.cell << ",\"digit\":" << (int)e.digit;
+			}
+			os << "}}";
+		}
+		os << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << num_dropped() << "}}\n";
+	}
+
+	/// Saves the events as Chrome trace JSON file.
+	bool save_chrome_trace(const std::string & f_path) const {
+		std::ofstream f(f_path, std::ios::trunc);
+		write_chrome_trace(f);
+		return (bool)f;
+	}
+
+private:
+	std::vector<TraceEvent> events;
+	std::uint64_t n_recorded = 0;
+	std::uint64_t n_searches = 0;
+	std::int32_t depth = 0;
+	const std::uint32_t sample_every;
+	const std::uint32_t thread_id;
+	const std::chrono::steady_clock::time_point t_start;
+};
+
+/// The tracer of the calling thread, nullptr if none is active.
+inline SearchTracer *& active_tracer() {
+	thread_local SearchTracer * tracer = nullptr;
+	return tracer;
+}
+
+/// Activates a tracer on the calling thread for its lifetime, if sampled.
+class TraceScope {
+
+public:
+	explicit TraceScope(SearchTracer & tracer) : prev(active_tracer()) {
+		if (tracer.next_sampled()) {
+			active_tracer() = &tracer;
+		}
+	}
+
+	TraceScope(const TraceScope &) = delete;
+	TraceScope & operator=(const TraceScope &) = delete;
+
+	~TraceScope() {
+		active_tracer() = prev;
+	}
+
+private:
+	SearchTracer * prev;
+};
+
+/// Records entering and leaving a search node with the active tracer.
+class TraceNode {
+
+public:
+	TraceNode() : tracer(active_tracer()) {
+		if (tracer) tracer->record(TraceNodeEnter);
+	}
+
+	TraceNode(const TraceNode &) = delete;
+	TraceNode & operator=(const TraceNode &) = delete;
+
+	~TraceNode() {
+		if (tracer) tracer->record(TraceNodeExit);
+	}
+
+	/// Records an event inside the node.
+	void event(const TraceEventType type, const sudoku_size_t cell = -1, const sudoku_value_t digit = 0) {
+		if (tracer) tracer->record(type, cell, digit);
+	}
+
+private:
+	SearchTracer * const tracer;
+};
+
+/// Flag to cancel running searches from another thread.
+///
+/// A token can have a parent, it is cancelled if the parent is. This allows
+/// to cancel a group of searches internally while still following an outer
+/// token.
+class CancelToken {
+
+public:
+	explicit CancelToken(const CancelToken * parent = nullptr) : parent(parent) {};
+
+	CancelToken(const CancelToken &) = delete;
+	CancelToken & operator=(const CancelToken &) = delete;
+
+	/// Requests all searches using this token to stop.
+	void cancel() {
+		flag.store(true, std::memory_order_relaxed);
+	}
+
+	/// Checks if this token or one of its parents was cancelled.
+	bool is_cancelled() const {
+		return flag.load(std::memory_order_relaxed) || (parent != nullptr && parent->is_cancelled());
+	}
+
+private:
+	std::atomic<bool> flag{ false };
+	const CancelToken * parent;
+};
+
+/// Limits of a search, see \ref SearchBudget.
+struct SearchLimits {
+	std::uint64_t max_nodes = 0; ///< Maximum number of search nodes, 0: unlimited.
+	std::chrono::microseconds timeout = std::chrono::microseconds::zero(); ///< Maximum wall time, 0: unlimited.
+};
+
+/// Node and time budget of a recursive search.
+///
+/// The search functions take an optional pointer to a budget and count every
+/// node they enter. The clock and the \ref CancelToken are only read every
+/// \ref check_interval nodes, so the overhead is a counter increment per
+/// node. Once the budget is exceeded, the search unwinds and returns
+/// \ref TimeoutSolution (or -4 for \ref solve_count_rec_depth()), if it
+/// was cancelled \ref CancelledSolution (or -5). The statistics remain
+/// valid afterwards.
+struct SearchBudget {
+	typedef std::chrono::steady_clock clock_t;
+
+	/// Number of nodes between two reads of the clock, power of two. The first
+	/// node is always checked.
+	static constexpr std::uint64_t check_interval = 64;
+
+	std::uint64_t max_nodes = 0; ///< Maximum number of nodes, 0: unlimited.
+	clock_t::time_point deadline = clock_t::time_point::max(); ///< Absolute deadline.
+	clock_t::time_point t_start = clock_t::now(); ///< Start of the search.
+	const CancelToken * cancel = nullptr; ///< Optional token to stop the search.
+
+	// Statistics
+	std::uint64_t n_nodes = 0; ///< Number of nodes entered.
+	std::uint64_t n_sols = 0; ///< Number of solutions found.
+	bool exceeded = false; ///< True if the limits were exceeded.
+	bool cancelled = false; ///< True if the token was cancelled.
+
+	SearchBudget() {};
+
+	/// Unlimited budget following the token 'cancel'.
+	explicit SearchBudget(const CancelToken * cancel) : cancel(cancel) {};
+
+	/// Budget starting now with the given limits.
+	explicit SearchBudget(const SearchLimits & limits, const CancelToken * cancel = nullptr)
+		: max_nodes(limits.max_nodes), cancel(cancel) {
+		if (limits.timeout > std::chrono::microseconds::zero()) {
+			deadline = t_start + limits.timeout;
+		}
+	}
+
+	/// Counts a node, returns true if the search has to stop.
+	bool enter_node() {
+		++n_nodes;
+		if (max_nodes > 0 && n_nodes > max_nodes) {
+			exceeded = true;
+		}
+		else if ((n_nodes & (check_interval - 1)) == 1) {
+			if (deadline != clock_t::time_point::max()) {
+				exceeded = exceeded || clock_t::now() >= deadline;
+			}
+			if (cancel != nullptr) {
+				cancelled = cancelled || cancel->is_cancelled();
+			}
+		}
+		return exceeded || cancelled;
+	}
+
+	/// True if the search was stopped for any reason.
+	bool stopped() const {
+		return exceeded || cancelled;
+	}
+
+	/// The result of a search that was stopped.
+	SolveResultFinal stop_result() const {
+		return cancelled ? CancelledSolution : TimeoutSolution;
+	}
+
+	/// Wall time since the start in seconds.
+	double seconds() const {
+		return std::chrono::duration<double>(clock_t::now() - t_start).count();
+	}
+};
+
+/// Prints the statistics of the budget.
+inline std::ostream& operator<<(std::ostream & os, const SearchBudget & budget) {
+	os << (budget.cancelled ? "Cancelled" : (budget.exceeded ? "Budget exceeded" : "Within budget")) << " after " << budget.n_nodes
+		<< " nodes, " << budget.n_sols << " solutions, " << budget.seconds() << " s\n";
+	return os;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transposition Table
+//
+// Different guess orders often lead to the same state after propagation.
+// \ref solve_brute_force_all() and \ref solve_count_rec_depth() can take a
+// \ref TranspositionTable that caches the result of the subtree below such a
+// state, keyed by its Zobrist hash. The table has a fixed size, each hash
+// maps to a bucket of \ref TranspositionTable::bucket_size entries and the
+// entry with the least work below it is replaced. The buckets are guarded
+// by a fixed number of mutexes (lock striping), so one table can be shared
+// by searches on several threads. Only the 64-bit hashes are compared, a
+// collision would return the result of a different state, which is
+// negligible at the sizes used here. Under a \ref PropagationProfile the
+// depths also depend on the stages below the node, which are mixed into the
+// key.
+
+/// Random keys for the numbers and possible numbers of all cells.
+struct ZobristKeys {
+	std::array<std::array<std::uint64_t, side_len>, tot_num_cells> number; ///< Number set in the cell.
+	std::array<std::array<std::uint64_t, side_len>, tot_num_cells> possible; ///< Number possible in the open cell.
+
+	ZobristKeys() {
+		std::mt19937_64 rng(0x9e3779b97f4a7c15ull);
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			for (sudoku_size_t num = 0; num < side_len; ++num) {
+				number[c][num] = rng();
+				possible[c][num] = rng();
+			}
+		}
+	}
+};
+
+/// Returns the keys, computed once.
+inline const ZobristKeys & get_zobrist_keys() {
+	static const ZobristKeys keys;
+	return keys;
+}
+
+/// Zobrist hash of the solver state, never 0.
+inline std::uint64_t zobrist_hash(const sudoku_data_t & s_data) {
+	const ZobristKeys & keys = get_zobrist_keys();
+	std::uint64_t h = 0;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const sudoku_size_t data_ind = c * n_stored_per_cell;
+		if (s_data[data_ind] > 0) {
+			h ^= keys.number[c][s_data[data_ind] - 1];
+			continue;
+		}
+		for (sudoku_size_t num = 0; num < side_len; ++num) {
+			if (s_data[data_ind + 1 + num] == 2) h ^= keys.possible[c][num];
+		}
+	}
+	return h != 0 ? h : 1;
+}
+
+/// Hash of the stages the active profile uses at the search node 'node' and below, 0 without a profile.
+///
+/// The depth found below a state depends on these stages, so they are mixed
+/// into its key, see \ref solve_count_rec_depth().
+inline std::uint64_t zobrist_profile_hash(const SearchDepthScope & node) {
+	const PropagationProfile * profile = active_profile();
+	if (profile == nullptr) {
+		return 0;
+	}
+	std::uint64_t h = 0xcbf29ce484222325ull;
+	for (int d = std::min(node.depth, profile->n_stages - 1); d < profile->n_stages; ++d) {
+		h = (h ^ profile->stages[d].techniques) * 0x100000001b3ull;
+		h = (h ^ (std::uint64_t)profile->stages[d].max_rounds) * 0x100000001b3ull;
+	}
+	return h;
+}
+
+/// Cached result of the subtree below a state.
+struct TranspositionEntry {
+	std::uint64_t key = 0; ///< Zobrist hash of the state, 0 if empty.
+	std::uint64_t work = 0; ///< Propagation rounds spent on the subtree, see \ref propagation_rounds().
+	int n_sols = -1; ///< Number of solutions, -1 if unknown.
+	int rel_depth = -3; ///< Result of \ref solve_count_rec_depth() relative to the depth of the state, -3 if unknown.
+	std::array<std::uint8_t, tot_num_cells> numbers; ///< Numbers of the state the search returned.
+};
+
+/// Bounded, thread-safe cache of subtree results.
+class TranspositionTable {
+
+public:
+	/// Number of entries per bucket.
+	static constexpr std::size_t bucket_size = 4;
+
+	/// Number of mutexes guarding the buckets.
+	static constexpr std::size_t n_stripes = 64;
+
+	/// Creates a table with at least 'n_entries' entries, rounded up to a power of two.
+	explicit TranspositionTable(const std::size_t n_entries = 1 << 16) {
+		std::size_t n_buckets = 1;
+		while (n_buckets * bucket_size < n_entries) {
+			n_buckets *= 2;
+		}
+		bucket_mask = n_buckets - 1;
+		entries.resize(n_buckets * bucket_size);
+	}
+
+	TranspositionTable(const TranspositionTable &) = delete;
+	TranspositionTable & operator=(const TranspositionTable &) = delete;
+
+	/// Looks up the number of solutions below the state 'key'.
+	///
+	/// On a hit, sets the numbers of 's_data' to those the search returned.
+	bool probe_count(const std::uint64_t key, int & n_sols, sudoku_data_t & s_data) {
+		return probe(key, [&](const TranspositionEntry & e) {
+			if (e.n_sols < 0) return false;
+			n_sols = e.n_sols;
+			copy_numbers(e, s_data);
+			return true;
+		});
+	}
+
+	/// Looks up the result of \ref solve_count_rec_depth() relative to the depth of the state 'key'.
+	///
+	/// On a hit, sets the numbers of 's_data' to those the search returned.
+	bool probe_depth(const std::uint64_t key, int & rel_depth, sudoku_data_t & s_data) {
+		return probe(key, [&](const TranspositionEntry & e) {
+			if (e.rel_depth == -3) return false;
+			rel_depth = e.rel_depth;
+			copy_numbers(e, s_data);
+			return true;
+		});
+	}
+
+	/// Stores the number of solutions below the state 'key' and the returned 's_data'.
+	void store_count(const std::uint64_t key, const int n_sols, const sudoku_data_t & s_data, const std::uint64_t work) {
+		store(key, work, [&](TranspositionEntry & e) {
+			e.n_sols = n_sols;
+			set_numbers(e, s_data);
+		});
+	}
+
+	/// Stores the relative result of \ref solve_count_rec_depth() below the state 'key' and the returned 's_data'.
+	void store_depth(const std::uint64_t key, const int rel_depth, const sudoku_data_t & s_data, const std::uint64_t work) {
+		store(key, work, [&](TranspositionEntry & e) {
+			e.rel_depth = rel_depth;
+			set_numbers(e, s_data);
+		});
+	}
+
+	/// Removes all entries and resets the statistics.
+	void clear() {
+		for (std::size_t s = 0; s < n_stripes; ++s) {
+			std::lock_guard<std::mutex> lock(locks[s]);
+			for (std::size_t b = s; b <= bucket_mask; b += n_stripes) {
+				std::fill(entries.begin() + b * bucket_size, entries.begin() + (b + 1) * bucket_size, TranspositionEntry());
+			}
+		}
+		n_probes = 0;
+		n_hits = 0;
+		n_stores = 0;
+		n_replaced = 0;
+	}
+
+	/// Number of entries.
+	std::size_t size() const {
+		return entries.size();
+	}
+
+	std::uint64_t probes() const { return n_probes; }
+	std::uint64_t hits() const { return n_hits; }
+	std::uint64_t stores() const { return n_stores; }
+	std::uint64_t replacements() const { return n_replaced; }
+
+private:
+	static void copy_numbers(const TranspositionEntry & e, sudoku_data_t & s_data) {
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			s_data[c * n_stored_per_cell] = e.numbers[c];
+		}
+	}
+
+	static void set_numbers(TranspositionEntry & e, const sudoku_data_t & s_data) {
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			e.numbers[c] = (std::uint8_t)s_data[c * n_stored_per_cell];
+		}
+	}
+
+	template<typename Func>
+	bool probe(const std::uint64_t key, Func && read) {
+		n_probes.fetch_add(1, std::memory_order_relaxed);
+		const std::size_t b = key & bucket_mask;
+		std::lock_guard<std::mutex> lock(locks[b % n_stripes]);
+		for (std::size_t k = b * bucket_size; k < (b + 1) * bucket_size; ++k) {
+			if (entries[k].key == key) {
+				const bool hit = read(entries[k]);
+				if (hit) n_hits.fetch_add(1, std::memory_order_relaxed);
+				return hit;
+			}
+		}
+		return false;
+	}
+
+	template<typename Func>
+	void store(const std::uint64_t key, const std::uint64_t work, Func && update) {
+		n_stores.fetch_add(1, std::memory_order_relaxed);
+		const std::size_t b = key & bucket_mask;
+		std::lock_guard<std::mutex> lock(locks[b % n_stripes]);
+
+		// Same state, else an empty entry, else the one with the least work
+		TranspositionEntry * slot = nullptr;
+		for (std::size_t k = b * bucket_size; k < (b + 1) * bucket_size; ++k) {
+			TranspositionEntry & e = entries[k];
+			if (e.key == key) {
+				slot = &e;
+				break;
+			}
+			if (slot == nullptr || (slot->key != 0 && (e.key == 0 || e.work < slot->work))) {
+				slot = &e;
+			}
+		}
+		if (slot->key != key) {
+			if (slot->key != 0) n_replaced.fetch_add(1, std::memory_order_relaxed);
+			*slot = TranspositionEntry();
+			slot->key = key;
+		}
+		slot->work = std::max(slot->work, work);
+		update(*slot);
+	}
+
+	std::vector<TranspositionEntry> entries;
+	std::size_t bucket_mask = 0;
+	std::array<std::mutex, n_stripes> locks;
+	std::atomic<std::uint64_t> n_probes{ 0 };
+	std::atomic<std::uint64_t> n_hits{ 0 };
+	std::atomic<std::uint64_t> n_stores{ 0 };
+	std::atomic<std::uint64_t> n_replaced{ 0 };
+};
+
+// Find the cell with the least numbers possible
+template<bool printDebugInfo = printDebugInfodefault>
+sudoku_size_t find_least_uncertain_cell(sudoku_data_t & s_data) {
+
+	sudoku_size_t min_poss_nums = side_len;
+	sudoku_size_t min_data_ind = 0;
+
+	// Iterate over all rows 
+	for (sudoku_size_t row_num = 0; row_num < side_len; ++row_num) {
+
+		// Iterate over all cols 
+		for (sudoku_size_t col_num = 0; col_num < side_len; ++col_num) {
+
+			const sudoku_size_t cell_ind = row_num + col_num * side_len;
+			const sudoku_size_t data_ind = cell_ind * n_stored_per_cell;
+
+			if (s_data[data_ind] > 0) continue;
 			// Iterate over all numbers
 			sudoku_size_t num_possible_num = 0;
 			for (sudoku_size_t num = 0; num < side_len; ++num) {
@@ -1042,14 +2400,25 @@ sudoku_size_t find_least_uncertain_cell(sudoku_data_t & s_data) {
 
 // Find a solution and check if it is unique
 template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
-SolveResultFinal solve_brute_force_multiple(sudoku_data_t & s_data) {
+SolveResultFinal solve_brute_force_multiple(sudoku_data_t & s_data, SearchBudget * budget = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return budget->stop_result();
+	}
+	TraceNode trace;
 
+	SearchDepthScope node;
 	// Try solving 
-	SolveStepRes init_stat = try_solving(s_data);
+	trace.event(TracePropagateBegin);
+	SolveStepRes init_stat = propagate_node(s_data, node);
+	trace.event(TracePropagateEnd);
 	if (init_stat == Invalid) {
+		trace.event(TraceContradiction);
 		return InvalidSolution;
 	}
 	else if (solved<square_height, square_width>(s_data)) {
+		trace.event(TraceSolution);
+		if (budget) ++budget->n_sols;
 		return UniqueSolution;
 	}
 
@@ -1069,9 +2438,13 @@ SolveResultFinal solve_brute_force_multiple(sudoku_data_t & s_data) {
 			// Copy data and set guessed value
 			s_data_copy = s_data;
 			s_data_copy[cell_picked] = curr_i + 1;
+			trace.event(TraceGuess, cell_picked / n_stored_per_cell, curr_i + 1);
 
 			// Recursion
-			res = solve_brute_force_multiple<square_height, square_width>(s_data_copy);
+			res = solve_brute_force_multiple<square_height, square_width>(s_data_copy, budget);
+			if (res == TimeoutSolution || res == CancelledSolution) {
+				return res;
+			}
 			if (res == UniqueSolution) {
 				s_data_res = s_data_copy;
 				num_sols += 1;
@@ -1099,14 +2472,20 @@ SolveResultFinal solve_brute_force_multiple(sudoku_data_t & s_data) {
 
 // Find a solution and check if it is unique
 template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo, typename RNG>
-SolveResultFinal solve_brute_force_multiple_random(sudoku_data_t & s_data, RNG & rng) {
+SolveResultFinal solve_brute_force_multiple_random(sudoku_data_t & s_data, RNG & rng, SearchBudget * budget = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return budget->stop_result();
+	}
 
+	SearchDepthScope node;
 	// Try solving 
-	SolveStepRes init_stat = try_solving(s_data);
+	SolveStepRes init_stat = propagate_node(s_data, node);
 	if (init_stat == Invalid) {
 		return InvalidSolution;
 	}
 	else if (solved<square_height, square_width>(s_data)) {
+		if (budget) ++budget->n_sols;
 		return UniqueSolution;
 	}
 
@@ -1135,7 +2514,10 @@ SolveResultFinal solve_brute_force_multiple_random(sudoku_data_t & s_data, RNG &
 			s_data_copy[cell_picked] = curr_i + 1;
 
 			// Recursion
-			res = solve_brute_force_multiple_random<square_height, square_width>(s_data_copy, rng);
+			res = solve_brute_force_multiple_random<square_height, square_width>(s_data_copy, rng, budget);
+			if (res == TimeoutSolution || res == CancelledSolution) {
+				return res;
+			}
 			if (res == UniqueSolution) {
 				s_data_res = s_data_copy;
 				num_sols += 1;
@@ -1162,18 +2544,38 @@ SolveResultFinal solve_brute_force_multiple_random(sudoku_data_t & s_data, RNG &
 }
 
 // Count all solutions and check if it is unique
+// Returns -1 if the search was stopped, the partial count is in the budget
+// The counts of the propagated states are cached in 'tt' if given
 template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
-int solve_brute_force_all(sudoku_data_t & s_data) {
+int solve_brute_force_all(sudoku_data_t & s_data, SearchBudget * budget = nullptr, TranspositionTable * tt = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return -1;
+	}
+	const std::uint64_t rounds_before = propagation_rounds();
 
+	SearchDepthScope node;
 	// Try solving 
-	SolveStepRes init_stat = try_solving(s_data);
+	SolveStepRes init_stat = propagate_node(s_data, node);
 	if (init_stat == Invalid) {
 		return 0;
 	}
 	else if (solved<square_height, square_width>(s_data)) {
+		if (budget) ++budget->n_sols;
 		return 1;
 	}
 
+	// Look up the propagated state
+	std::uint64_t tt_key = 0;
+	if (tt) {
+		tt_key = zobrist_hash(s_data);
+		int n_cached = 0;
+		if (tt->probe_count(tt_key, n_cached, s_data)) {
+			if (budget) budget->n_sols += n_cached;
+			return n_cached;
+		}
+	}
+
 	// Solve by guessing recursively
 	sudoku_data_t s_data_copy = s_data;
 	sudoku_data_t s_data_res = s_data;
@@ -1189,7 +2591,10 @@ int solve_brute_force_all(sudoku_data_t & s_data) {
 			s_data_copy[cell_picked] = i + 1;
 
 			// Recursion
-			const int res = solve_brute_force_all<square_height, square_width>(s_data_copy);
+			const int res = solve_brute_force_all<square_height, square_width>(s_data_copy, budget, tt);
+			if (res < 0) {
+				return -1;
+			}
 			num_sols += res;
 			if (res > 0) {
 				s_data_res = s_data_copy;
@@ -1197,53 +2602,38 @@ int solve_brute_force_all(sudoku_data_t & s_data) {
 		}
 	}
 	s_data = s_data_res;
+	if (tt) tt->store_count(tt_key, num_sols, s_data, propagation_rounds() - rounds_before);
 	return num_sols;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Sudoku Generation
-
-// Type Definition
-typedef int num_sud_t;
-typedef int rec_depth_t;
-typedef unsigned int num_filled_t;
-typedef std::string sud_char_t;
-typedef std::pair<raw_sudoku_t, raw_sudoku_t> sud_and_sol_t;
-typedef std::map<sud_char_t, std::vector<sud_and_sol_t> > sud_coll_t;
-
-typedef std::pair<SolveResultFinal, rec_depth_t> FullSol_t;
-
-// -3: Error occurred
-// -2: Invalid
-// -1: Multiple
-// 0: Unique, no recursion needed
-// n > 0: Unique, min. rec. depth n
-
-// Find a solution and check if it is unique
-// Additionally find recursion depth
+// Count the solutions, but stop as soon as 'max_sols' were found
+// Returns -1 if the search was stopped, the partial count is in the budget
 template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
-rec_depth_t solve_count_rec_depth(sudoku_data_t & s_data, const rec_depth_t rec_dep = 0) {
+int solve_brute_force_count(sudoku_data_t & s_data, const int max_sols, SearchBudget * budget = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return -1;
+	}
 
+	SearchDepthScope node;
 	// Try solving 
-	SolveStepRes init_stat = try_solving(s_data);
+	SolveStepRes init_stat = propagate_node(s_data, node);
 	if (init_stat == Invalid) {
-		return -2;
+		return 0;
 	}
 	else if (solved<square_height, square_width>(s_data)) {
-		return rec_dep;
+		if (budget) ++budget->n_sols;
+		return 1;
 	}
 
 	// Solve by guessing recursively
 	sudoku_data_t s_data_copy = s_data;
 	sudoku_data_t s_data_res = s_data;
 	const sudoku_size_t cell_picked = find_least_uncertain_cell(s_data);
-	rec_depth_t res = -3;
-	sudoku_size_t num_sols = 0;
-
-	rec_depth_t curr_min_rd = -3;
+	int num_sols = 0;
 
 	// Loop over all possible guesses
-	for (sudoku_size_t i = 0; i < side_len; ++i) {
+	for (sudoku_size_t i = 0; i < side_len && num_sols < max_sols; ++i) {
 
 		if (s_data[cell_picked + 1 + i] == 2) {
 			// Copy data and set guessed value
@@ -1251,43 +2641,893 @@ rec_depth_t solve_count_rec_depth(sudoku_data_t & s_data, const rec_depth_t rec_
 			s_data_copy[cell_picked] = i + 1;
 
 			// Recursion
-			res = solve_count_rec_depth<square_height, square_width>(
-				s_data_copy, rec_dep + 1);
-			if (res >= 0) {
-				s_data_res = s_data_copy;
-				num_sols += 1;
-				if (curr_min_rd == -3 || res < curr_min_rd) {
-					curr_min_rd = res;
-				}
-			}
-			if (num_sols > 1 || res == -1) {
-				s_data = s_data_copy;
+			const int res = solve_brute_force_count<square_height, square_width>(s_data_copy, max_sols - num_sols, budget);
+			if (res < 0) {
 				return -1;
 			}
+			num_sols += res;
+			if (res > 0) {
+				s_data_res = s_data_copy;
+			}
 		}
 	}
 	s_data = s_data_res;
-	if (num_sols == 1) {
-		return curr_min_rd;
+	return num_sols;
+}
+
+// Recursion of enumerate_solutions(), returns false if the enumeration has to stop
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo, typename Func>
+bool enumerate_solutions_rec(sudoku_data_t & s_data, Func & f, int & num_sols, const int max_sols, SearchBudget * budget) {
+
+	if (budget && budget->enter_node()) {
+		return false;
 	}
-	if (num_sols == 0) {
-		return -2;
+
+	SearchDepthScope node;
+	// Try solving 
+	SolveStepRes init_stat = propagate_node(s_data, node);
+	if (init_stat == Invalid) {
+		return true;
 	}
-	if (num_sols > 1) {
-		return -1;
+	else if (solved<square_height, square_width>(s_data)) {
+		if (budget) ++budget->n_sols;
+		++num_sols;
+		const raw_sudoku_t sol = get_raw_sudoku(s_data);
+		return f(sol) && num_sols < max_sols;
 	}
 
-	// Should not happen
-	return -3;
-}
+	// Solve by guessing recursively
+	sudoku_data_t s_data_copy = s_data;
+	const sudoku_size_t cell_picked = find_least_uncertain_cell(s_data);
 
-// Counts the number that is currently set in the given sudoku
-sudoku_size_t count_num_known_numbers(const sudoku_data_t & s_data) {
+	// Loop over all possible guesses
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
 
-	sudoku_size_t num_ct = 0;
+		if (s_data[cell_picked + 1 + i] == 2) {
+			// Copy data and set guessed value
+			s_data_copy = s_data;
+			s_data_copy[cell_picked] = i + 1;
 
-	// Iterate over all rows 
-	for (sudoku_size_t row_num = 0; row_num < side_len; ++row_num) {
+			// Recursion
+			if (!enumerate_solutions_rec<square_height, square_width, printDebugInfo>(s_data_copy, f, num_sols, max_sols, budget)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Enumerate the solutions, calls 'f(const raw_sudoku_t &)' for each solution as soon as it is found
+// Stops if 'f' returns false or 'max_sols' solutions were found, nothing is stored
+// Returns the number of solutions passed to 'f', -1 if the search was stopped by the budget
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo, typename Func>
+int enumerate_solutions(sudoku_data_t & s_data, Func && f, const int max_sols = std::numeric_limits<int>::max(),
+	SearchBudget * budget = nullptr) {
+	int num_sols = 0;
+	if (max_sols > 0) {
+		enumerate_solutions_rec<square_height, square_width, printDebugInfo>(s_data, f, num_sols, max_sols, budget);
+	}
+	return budget && budget->stopped() ? -1 : num_sols;
+}
+
+/// Returns up to 'max_sols' solutions of the raw sudoku.
+inline std::vector<raw_sudoku_t> find_solutions(const raw_sudoku_t & s, const int max_sols) {
+	std::vector<raw_sudoku_t> sols;
+	sudoku_data_t s_data = init_sudoku_with_raw(s);
+	auto_fill(s_data, true);
+	enumerate_solutions<square_height, square_width>(s_data, [&](const raw_sudoku_t & sol) {
+		sols.push_back(sol);
+		return true;
+	}, max_sols);
+	return sols;
+}
+
+/// Checks if the raw sudoku has exactly one solution.
+///
+/// Returns false if the search was stopped by the 'budget'.
+inline bool has_unique_solution(const raw_sudoku_t & s, SearchBudget * budget = nullptr) {
+	sudoku_data_t s_data = init_sudoku_with_raw(s);
+	auto_fill(s_data, true);
+	return solve_brute_force_multiple<square_height, square_width>(s_data, budget) == UniqueSolution;
+}
+
+/// Estimated number of solutions, see \ref estimate_solution_count().
+struct SolutionCountEstimate {
+	double mean = 0.0; ///< Estimated number of solutions.
+	double std_error = 0.0; ///< Standard error of the estimate.
+	double lower = 0.0; ///< Lower end of the 95% confidence interval, at least 0.
+	double upper = 0.0; ///< Upper end of the 95% confidence interval.
+	int n_probes = 0; ///< Number of completed probes.
+	int n_hits = 0; ///< Number of probes that ended in a solution.
+};
+
+/// Prints the estimate with its confidence interval.
+inline std::ostream& operator<<(std::ostream & os, const SolutionCountEstimate & est) {
+	os << "~" << est.mean << " solutions, 95% CI [" << est.lower << ", " << est.upper << "], "
+		<< est.n_hits << " / " << est.n_probes << " probes solved";
+	return os;
+}
+
+// Estimate the number of solutions with Knuth's estimator
+// Each probe follows a single random path down the search tree of
+// solve_brute_force_multiple_random() and multiplies the numbers of
+// possible guesses along the way. If it ends in a solution, the product is
+// an unbiased estimate of the number of solutions, otherwise the estimate
+// is 0. The mean over 'n_probes' probes is returned, the confidence interval
+// assumes normally distributed means. Probes that were stopped by the budget
+// are not counted.
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo, typename RNG>
+SolutionCountEstimate estimate_solution_count(const sudoku_data_t & s_data, const int n_probes, RNG & rng,
+	SearchBudget * budget = nullptr) {
+
+	SolutionCountEstimate est;
+	double sum = 0.0;
+	double sum_sq = 0.0;
+	for (int probe = 0; probe < n_probes; ++probe) {
+		sudoku_data_t s_data_copy = s_data;
+		double weight = 1.0;
+		bool stopped = false;
+		while (true) {
+			if (budget && budget->enter_node()) {
+				stopped = true;
+				break;
+			}
+
+			// Try solving
+			if (try_solving(s_data_copy) == Invalid) {
+				weight = 0.0;
+				break;
+			}
+			else if (solved<square_height, square_width>(s_data_copy)) {
+				++est.n_hits;
+				break;
+			}
+
+			// Guess randomly among the possible numbers
+			const sudoku_size_t cell_picked = find_least_uncertain_cell(s_data_copy);
+			std::array<sudoku_value_t, side_len> possible;
+			sudoku_size_t n_possible = 0;
+			for (sudoku_size_t i = 0; i < side_len; ++i) {
+				if (s_data_copy[cell_picked + 1 + i] == 2) possible[n_possible++] = i;
+			}
+			if (n_possible == 0) {
+				weight = 0.0;
+				break;
+			}
+			weight *= n_possible;
+			s_data_copy[cell_picked] = possible[std::uniform_int_distribution<sudoku_size_t>(0, n_possible - 1)(rng)] + 1;
+		}
+		if (stopped) {
+			break;
+		}
+		++est.n_probes;
+		sum += weight;
+		sum_sq += weight * weight;
+	}
+
+	if (est.n_probes > 0) {
+		const double n = est.n_probes;
+		est.mean = sum / n;
+		const double var = n > 1 ? std::max(0.0, (sum_sq - n * est.mean * est.mean) / (n - 1)) : 0.0;
+		est.std_error = std::sqrt(var / n);
+		est.lower = std::max(0.0, est.mean - 1.96 * est.std_error);
+		est.upper = est.mean + 1.96 * est.std_error;
+	}
+	return est;
+}
+
+/// Estimates the number of solutions of the raw sudoku with 'n_probes' probes.
+///
+/// See \ref estimate_solution_count(), the probes can be bounded in time by
+/// the 'budget'.
+inline SolutionCountEstimate estimate_solutions(const raw_sudoku_t & s, const int n_probes = 1000,
+	SearchBudget * budget = nullptr, const std::uint32_t rng_seed = seed) {
+	sudoku_data_t s_data = init_sudoku_with_raw(s);
+	auto_fill(s_data, true);
+	std::mt19937 rng(rng_seed);
+	return estimate_solution_count<square_height, square_width>(s_data, n_probes, rng, budget);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sudoku Generation
+
+// Type Definition
+typedef int num_sud_t;
+typedef int rec_depth_t;
+typedef unsigned int num_filled_t;
+typedef std::string sud_char_t;
+typedef std::pair<raw_sudoku_t, raw_sudoku_t> sud_and_sol_t;
+
+/// Number of bytes of a packed sudoku, two cells per byte.
+constexpr sudoku_size_t packed_sudoku_size = (tot_num_cells + 1) / 2;
+
+static_assert(side_len < 16 && "Cells do not fit into 4 bits.");
+
+/// Sudoku packed with 4 bits per cell.
+typedef std::array<std::uint8_t, packed_sudoku_size> packed_sudoku_t;
+
+/// Packs a raw sudoku, inverse of \ref unpack_sudoku().
+inline packed_sudoku_t pack_sudoku(const raw_sudoku_t & s) {
+	packed_sudoku_t p;
+	std::fill(p.begin(), p.end(), (std::uint8_t)0);
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		p[i / 2] |= (std::uint8_t)(s[i] << (4 * (i % 2)));
+	}
+	return p;
+}
+
+/// Unpacks a packed sudoku, inverse of \ref pack_sudoku().
+inline raw_sudoku_t unpack_sudoku(const std::uint8_t * p) {
+	raw_sudoku_t s;
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		s[i] = (p[i / 2] >> (4 * (i % 2))) & 0xF;
+	}
+	return s;
+}
+
+/// Hashes the bytes of a packed sudoku (FNV-1a).
+inline std::uint64_t hash_packed_sudoku(const packed_sudoku_t & p) {
+	std::uint64_t h = 14695981039346656037ull;
+	for (const std::uint8_t b : p) {
+		h ^= b;
+		h *= 1099511628211ull;
+	}
+	return h ^ (h >> 29);
+}
+
+/// Returns the level that is encoded in the description 'desc'.
+///
+/// See \ref generate_sud_char(). Returns -1 if 'desc' does not start with a digit.
+inline rec_depth_t get_sud_char_level(const sud_char_t & desc) {
+	if (desc.empty()) {
+		return 0;
+	}
+	return desc[0] >= '0' && desc[0] <= '9' ? desc[0] - '0' : -1;
+}
+
+/// Collection of sudokus with their solutions.
+///
+/// The sudokus are stored packed and every sudoku is stored at most once,
+/// duplicates are rejected with an open addressing hash set. Entries can be
+/// looked up by their description (see \ref generate_sud_char()) and by level.
+class SudokuCollection {
+
+public:
+	/// Index of an entry.
+	typedef std::uint32_t entry_ind_t;
+
+	/// A stored sudoku with its solution.
+	struct Entry {
+		packed_sudoku_t sud; ///< The sudoku.
+		packed_sudoku_t sol; ///< Its solution.
+		std::uint32_t sig_ind; ///< Index of the description.
+	};
+
+	/// Adds a sudoku if it is new and there are at most 'max_sud_per_key'
+	/// sudokus with the same description already.
+	///
+	/// Descriptions that do not encode a valid level are rejected.
+	bool add(const sud_char_t & desc, const raw_sudoku_t & s, const raw_sudoku_t & s_sol, const num_sud_t max_sud_per_key = 100) {
+
+		// Reject invalid descriptions
+		const rec_depth_t lvl = get_sud_char_level(desc);
+		if (lvl < 0) {
+			return false;
+		}
+
+		// Reject duplicates
+		const packed_sudoku_t p = pack_sudoku(s);
+		const std::size_t slot = find_slot(p);
+		if (slots[slot] != empty_slot) {
+			return false;
+		}
+
+		// Check the number with the same description
+		const auto pos = sig_index.find(desc);
+		std::uint32_t sig_ind = 0;
+		if (pos == sig_index.end()) {
+			sig_ind = (std::uint32_t)sigs.size();
+			sig_index[desc] = sig_ind;
+			sigs.push_back(desc);
+			sig_entries.emplace_back();
+		}
+		else {
+			sig_ind = pos->second;
+			if (sig_entries[sig_ind].size() > (std::size_t)max_sud_per_key) {
+				return false;
+			}
+		}
+
+		// Store and index
+		const entry_ind_t ind = (entry_ind_t)entries.size();
+		entries.push_back(Entry{ p, pack_sudoku(s_sol), sig_ind });
+		slots[slot] = ind;
+		sig_entries[sig_ind].push_back(ind);
+		if ((std::size_t)lvl >= lvl_entries.size()) {
+			lvl_entries.resize(lvl + 1);
+		}
+		lvl_entries[lvl].push_back(ind);
+		if (4 * entries.size() > 3 * slots.size()) {
+			rehash(2 * slots.size());
+		}
+		return true;
+	}
+
+	/// Checks if the sudoku 's' is in the collection.
+	bool contains(const raw_sudoku_t & s) const {
+		return slots[find_slot(pack_sudoku(s))] != empty_slot;
+	}
+
+	/// Reserves space for 'n' sudokus.
+	void reserve(const std::size_t n) {
+		entries.reserve(n);
+		std::size_t n_slots = slots.size();
+		while (3 * n_slots < 4 * n) {
+			n_slots *= 2;
+		}
+		if (n_slots != slots.size()) {
+			rehash(n_slots);
+		}
+	}
+
+	/// Number of stored sudokus.
+	std::size_t size() const {
+		return entries.size();
+	}
+
+	/// Returns the sudoku and its solution with index 'ind'.
+	sud_and_sol_t get(const entry_ind_t ind) const {
+		const Entry & e = entries[ind];
+		return std::make_pair(unpack_sudoku(e.sud.data()), unpack_sudoku(e.sol.data()));
+	}
+
+	/// Returns the description of the sudoku with index 'ind'.
+	const sud_char_t & get_desc(const entry_ind_t ind) const {
+		return sigs[entries[ind].sig_ind];
+	}
+
+	/// Returns the packed entry with index 'ind'.
+	const Entry & get_entry(const entry_ind_t ind) const {
+		return entries[ind];
+	}
+
+	/// Returns all different descriptions in sorted order.
+	std::vector<sud_char_t> get_sorted_descs() const {
+		std::vector<sud_char_t> res = sigs;
+		std::sort(res.begin(), res.end());
+		return res;
+	}
+
+	/// Returns the indices of all sudokus with description 'desc'.
+	const std::vector<entry_ind_t> & with_desc(const sud_char_t & desc) const {
+		const auto pos = sig_index.find(desc);
+		return pos == sig_index.end() ? no_entries : sig_entries[pos->second];
+	}
+
+	/// Returns the indices of all sudokus with level 'lvl'.
+	const std::vector<entry_ind_t> & with_level(const rec_depth_t lvl) const {
+		return lvl < 0 || (std::size_t)lvl >= lvl_entries.size() ? no_entries : lvl_entries[lvl];
+	}
+
+private:
+	static constexpr entry_ind_t empty_slot = 0xFFFFFFFF;
+
+	/// Finds the slot of 'p' or the empty slot where it would be inserted.
+	std::size_t find_slot(const packed_sudoku_t & p) const {
+		const std::size_t mask = slots.size() - 1;
+		std::size_t slot = (std::size_t)hash_packed_sudoku(p) & mask;
+		while (slots[slot] != empty_slot && entries[slots[slot]].sud != p) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	/// Rebuilds the hash set with 'n_slots' slots, a power of two.
+	void rehash(const std::size_t n_slots) {
+		slots.assign(n_slots, empty_slot);
+		for (entry_ind_t i = 0; i < (entry_ind_t)entries.size(); ++i) {
+			slots[find_slot(entries[i].sud)] = i;
+		}
+	}
+
+	std::vector<Entry> entries;
+	std::vector<entry_ind_t> slots = std::vector<entry_ind_t>(1024, empty_slot);
+
+	// Secondary indices
+	std::vector<sud_char_t> sigs;
+	std::unordered_map<sud_char_t, std::uint32_t> sig_index;
+	std::vector<std::vector<entry_ind_t> > sig_entries;
+	std::vector<std::vector<entry_ind_t> > lvl_entries;
+	std::vector<entry_ind_t> no_entries;
+};
+
+typedef SudokuCollection sud_coll_t;
+
+typedef std::pair<SolveResultFinal, rec_depth_t> FullSol_t;
+
+// -3: Error occurred
+// -2: Invalid
+// -1: Multiple
+// 0: Unique, no recursion needed
+// n > 0: Unique, min. rec. depth n
+// -4: Search budget exceeded
+// -5: Search cancelled
+
+// Find a solution and check if it is unique
+// Additionally find recursion depth
+// The results of the propagated states are cached in 'tt' if given
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
+rec_depth_t solve_count_rec_depth(sudoku_data_t & s_data, const rec_depth_t rec_dep = 0, SearchBudget * budget = nullptr,
+	TranspositionTable * tt = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return budget->cancelled ? -5 : -4;
+	}
+	TraceNode trace;
+	const std::uint64_t rounds_before = propagation_rounds();
+
+	SearchDepthScope node;
+	// Try solving 
+	trace.event(TracePropagateBegin);
+	SolveStepRes init_stat = propagate_node(s_data, node);
+	trace.event(TracePropagateEnd);
+	if (init_stat == Invalid) {
+		trace.event(TraceContradiction);
+		return -2;
+	}
+	else if (solved<square_height, square_width>(s_data)) {
+		trace.event(TraceSolution);
+		if (budget) ++budget->n_sols;
+		return rec_dep;
+	}
+
+	// Look up the propagated state, the depths are stored relative to it
+	std::uint64_t tt_key = 0;
+	if (tt) {
+		tt_key = zobrist_hash(s_data) ^ zobrist_profile_hash(node);
+		tt_key = tt_key != 0 ? tt_key : 1;
+		rec_depth_t rel_cached = -3;
+		if (tt->probe_depth(tt_key, rel_cached, s_data)) {
+			return rel_cached >= 0 ? rec_dep + rel_cached : rel_cached;
+		}
+	}
+	auto store = [&](const rec_depth_t result) {
+		if (tt) tt->store_depth(tt_key, result >= 0 ? result - rec_dep : result, s_data, propagation_rounds() - rounds_before);
+		return result;
+	};
+
+	// Solve by guessing recursively
+	sudoku_data_t s_data_copy = s_data;
+	sudoku_data_t s_data_res = s_data;
+	const sudoku_size_t cell_picked = find_least_uncertain_cell(s_data);
+	rec_depth_t res = -3;
+	sudoku_size_t num_sols = 0;
+
+	rec_depth_t curr_min_rd = -3;
+
+	// Loop over all possible guesses
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
+
+		if (s_data[cell_picked + 1 + i] == 2) {
+			// Copy data and set guessed value
+			s_data_copy = s_data;
+			s_data_copy[cell_picked] = i + 1;
+			trace.event(TraceGuess, cell_picked / n_stored_per_cell, i + 1);
+
+			// Recursion
+			res = solve_count_rec_depth<square_height, square_width>(
+				s_data_copy, rec_dep + 1, budget, tt);
+			if (res == -4 || res == -5) {
+				return res;
+			}
+			if (res >= 0) {
+				s_data_res = s_data_copy;
+				num_sols += 1;
+				if (curr_min_rd == -3 || res < curr_min_rd) {
+					curr_min_rd = res;
+				}
+			}
+			if (num_sols > 1 || res == -1) {
+				s_data = s_data_copy;
+				return store(-1);
+			}
+		}
+	}
+	s_data = s_data_res;
+	if (num_sols == 1) {
+		return store(curr_min_rd);
+	}
+	if (num_sols == 0) {
+		return store(-2);
+	}
+	if (num_sols > 1) {
+		return store(-1);
+	}
+
+	// Should not happen
+	return -3;
+}
+
+/// Candidates of all cells for \ref search_cand_grid(), a single bit for set cells.
+struct CandSearchGrid {
+	cand_grid_t cand; ///< Candidates per cell.
+	std::array<bool, tot_num_cells> set; ///< True if a number is set in the cell.
+	std::array<bool, tot_num_cells> placed; ///< True if the number of the set cell was removed from its peers.
+};
+
+/// Converts the solver state, only the possible numbers of the open cells are candidates.
+inline CandSearchGrid to_cand_search_grid(const sudoku_data_t & s_data) {
+	CandSearchGrid g;
+	g.set.fill(false);
+	g.placed.fill(false);
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const sudoku_size_t data_ind = c * n_stored_per_cell;
+		if (s_data[data_ind] > 0) {
+			g.cand[c] = (cand_mask_t)(1 << (s_data[data_ind] - 1));
+			g.set[c] = true;
+			continue;
+		}
+		cand_mask_t m = 0;
+		for (sudoku_size_t num = 0; num < side_len; ++num) {
+			if (s_data[data_ind + 1 + num] == 2) m |= (cand_mask_t)(1 << num);
+		}
+		g.cand[c] = m;
+	}
+	return g;
+}
+
+// Propagate on the candidates until nothing changes, returns false on a contradiction
+// Uses the techniques of try_solving(): Naked and hidden singles, numbers
+// of a row or col confined to one square and numbers of a square confined
+// to one row or col. They only remove candidates that are not part of any
+// solution, so they stop at the same candidates as try_solving() in
+// whatever order they run.
+inline bool propagate_cand_grid(CandSearchGrid & g) {
+	constexpr sudoku_size_t n_square_rows = side_len / square_height;
+	constexpr sudoku_size_t n_square_cols = side_len / square_width;
+	const SudokuUnits & units = get_units();
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		// Naked singles: Remove the numbers of set cells from their peers
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			const cand_mask_t m = g.cand[c];
+			if (m == 0) return false;
+			if (g.placed[c] || (m & (m - 1)) != 0) continue;
+			g.set[c] = true;
+			g.placed[c] = true;
+			for (const sudoku_size_t p : units.peers[c]) {
+				if ((g.cand[p] & m) == 0) continue;
+				g.cand[p] &= (cand_mask_t)~m;
+				if (g.cand[p] == 0) return false;
+				changed = true;
+			}
+		}
+
+		// Hidden singles: Numbers possible in only one cell of a unit
+		for (const auto& u : units.cells) {
+			cand_mask_t once = 0;
+			cand_mask_t twice = 0;
+			for (const sudoku_size_t c : u) {
+				twice |= once & g.cand[c];
+				once |= g.cand[c];
+			}
+			if (once != all_cands) return false;
+			const cand_mask_t hidden = once & (cand_mask_t)~twice;
+			if (hidden == 0) continue;
+			for (const sudoku_size_t c : u) {
+				const cand_mask_t h = g.cand[c] & hidden;
+				if (h == 0 || h == g.cand[c]) continue;
+				if ((h & (h - 1)) != 0) return false;
+				g.cand[c] = h;
+				changed = true;
+			}
+		}
+		if (changed) continue;
+
+		// Candidates of the parts of the rows and cols in each square
+		std::array<std::array<cand_mask_t, n_square_cols>, side_len> row_parts = {};
+		std::array<std::array<cand_mask_t, n_square_rows>, side_len> col_parts = {};
+		for (sudoku_size_t r = 0; r < side_len; ++r) {
+			for (sudoku_size_t c = 0; c < side_len; ++c) {
+				row_parts[r][c / square_width] |= g.cand[r * side_len + c];
+				col_parts[c][r / square_height] |= g.cand[r * side_len + c];
+			}
+		}
+		auto eliminate = [&](const sudoku_size_t c, const cand_mask_t m) {
+			if ((g.cand[c] & m) == 0) return true;
+			g.cand[c] &= (cand_mask_t)~m;
+			changed = true;
+			return g.cand[c] != 0;
+		};
+		for (sudoku_size_t r = 0; r < side_len; ++r) {
+			const sudoku_size_t sq_row = r / square_height;
+			for (sudoku_size_t sq_col = 0; sq_col < n_square_cols; ++sq_col) {
+
+				// Candidates of the other parts of the row and of the square
+				cand_mask_t in_row = 0;
+				for (sudoku_size_t k = 0; k < n_square_cols; ++k) {
+					if (k != sq_col) in_row |= row_parts[r][k];
+				}
+				cand_mask_t in_square = 0;
+				for (sudoku_size_t k = sq_row * square_height; k < (sq_row + 1) * square_height; ++k) {
+					if (k != r) in_square |= row_parts[k][sq_col];
+				}
+				// Confined to this part in the square or in the row
+				const cand_mask_t pointing = row_parts[r][sq_col] & (cand_mask_t)~in_square;
+				const cand_mask_t claimed = row_parts[r][sq_col] & (cand_mask_t)~in_row;
+				for (sudoku_size_t c = 0; c < side_len; ++c) {
+					const bool in_part = c / square_width == sq_col;
+					if (!in_part && pointing && !eliminate(r * side_len + c, pointing)) return false;
+				}
+				for (sudoku_size_t k = sq_row * square_height; k < (sq_row + 1) * square_height; ++k) {
+					if (k == r || claimed == 0) continue;
+					for (sudoku_size_t c = sq_col * square_width; c < (sq_col + 1) * square_width; ++c) {
+						if (!eliminate(k * side_len + c, claimed)) return false;
+					}
+				}
+			}
+		}
+		for (sudoku_size_t c = 0; c < side_len; ++c) {
+			const sudoku_size_t sq_col = c / square_width;
+			for (sudoku_size_t sq_row = 0; sq_row < n_square_rows; ++sq_row) {
+				// Candidates of the other parts of the col and of the square
+				cand_mask_t in_col = 0;
+				for (sudoku_size_t k = 0; k < n_square_rows; ++k) {
+					if (k != sq_row) in_col |= col_parts[c][k];
+				}
+				cand_mask_t in_square = 0;
+				for (sudoku_size_t k = sq_col * square_width; k < (sq_col + 1) * square_width; ++k) {
+					if (k != c) in_square |= col_parts[k][sq_row];
+				}
+				// Confined to this part in the square or in the col
+				const cand_mask_t pointing = col_parts[c][sq_row] & (cand_mask_t)~in_square;
+				const cand_mask_t claimed = col_parts[c][sq_row] & (cand_mask_t)~in_col;
+				for (sudoku_size_t r = 0; r < side_len; ++r) {
+					const bool in_part = r / square_height == sq_row;
+					if (!in_part && pointing && !eliminate(r * side_len + c, pointing)) return false;
+				}
+				for (sudoku_size_t k = sq_col * square_width; k < (sq_col + 1) * square_width; ++k) {
+					if (k == c || claimed == 0) continue;
+					for (sudoku_size_t r = sq_row * square_height; r < (sq_row + 1) * square_height; ++r) {
+						if (!eliminate(r * side_len + k, claimed)) return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// Search the solutions of the candidates 'g', counted in 'n_sols' up to 'max_sols'
+// The first solution is written to 'sol'. Returns false if the search was stopped.
+inline bool search_cand_grid(CandSearchGrid & g, const int max_sols, int & n_sols, raw_sudoku_t & sol,
+	SearchBudget * budget = nullptr) {
+
+	if (budget && budget->enter_node()) {
+		return false;
+	}
+	if (!propagate_cand_grid(g)) {
+		return true;
+	}
+
+	// Guess in the open cell with the fewest candidates
+	sudoku_size_t cell_picked = tot_num_cells;
+	int min_cands = side_len + 1;
+	for (sudoku_size_t c = 0; c < tot_num_cells && min_cands > 2; ++c) {
+		const int n = count_cands(g.cand[c]);
+		if (n > 1 && n < min_cands) {
+			min_cands = n;
+			cell_picked = c;
+		}
+	}
+	if (cell_picked == tot_num_cells) {
+		if (n_sols++ == 0) {
+			for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+				sol[c] = mask_to_number(g.cand[c]);
+			}
+		}
+		if (budget) ++budget->n_sols;
+		return true;
+	}
+	cand_mask_t cands = g.cand[cell_picked];
+	while (cands && n_sols < max_sols) {
+		const cand_mask_t bit = cands & (cand_mask_t)(-cands);
+		cands &= (cand_mask_t)~bit;
+		CandSearchGrid g_copy = g;
+		g_copy.cand[cell_picked] = bit;
+		if (!search_cand_grid(g_copy, max_sols, n_sols, sol, budget)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Follow the branches of solve_count_rec_depth() that contain the solution 'sol'
+// Returns the depth of the node where the solution is set
+template<sudoku_size_t square_height, sudoku_size_t square_width>
+rec_depth_t grade_rec_depth_path(sudoku_data_t & s_data, const raw_sudoku_t & sol, const rec_depth_t rec_dep) {
+
+	SearchDepthScope node;
+	if (propagate_node(s_data, node) == Invalid) {
+		return -2;
+	}
+	if (solved<square_height, square_width>(s_data)) {
+		return rec_dep;
+	}
+	const sudoku_size_t cell_picked = find_least_uncertain_cell(s_data);
+	s_data[cell_picked] = sol[cell_picked / n_stored_per_cell];
+	return grade_rec_depth_path<square_height, square_width>(s_data, sol, rec_dep + 1);
+}
+
+// True if a technique of try_solving() changes anything in the first round
+// The numbers of cells set since the last round may still be possible in
+// their peers, try_solving() only removes them at the end of each round.
+// Only the open cells and the numbers not set in a unit are considered,
+// like the techniques do.
+inline bool cand_grid_round_changes(const CandSearchGrid & g) {
+	constexpr sudoku_size_t n_square_rows = side_len / square_height;
+	constexpr sudoku_size_t n_square_cols = side_len / square_width;
+	const SudokuUnits & units = get_units();
+
+	// Naked singles
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (!g.set[c] && count_cands(g.cand[c]) == 1) return true;
+	}
+
+	// Hidden singles, numbers set per unit
+	std::array<cand_mask_t, 3 * side_len> set_in = {};
+	for (sudoku_size_t u = 0; u < 3 * side_len; ++u) {
+		cand_mask_t once = 0;
+		cand_mask_t twice = 0;
+		for (const sudoku_size_t c : units.cells[u]) {
+			if (g.set[c]) {
+				set_in[u] |= g.cand[c];
+				continue;
+			}
+			twice |= once & g.cand[c];
+			once |= g.cand[c];
+		}
+		if (once & (cand_mask_t)~twice & (cand_mask_t)~set_in[u]) return true;
+	}
+
+	// Candidates of the open cells of the parts of the rows and cols in each square
+	std::array<std::array<cand_mask_t, n_square_cols>, side_len> row_parts = {};
+	std::array<std::array<cand_mask_t, n_square_rows>, side_len> col_parts = {};
+	for (sudoku_size_t r = 0; r < side_len; ++r) {
+		for (sudoku_size_t c = 0; c < side_len; ++c) {
+			if (g.set[r * side_len + c]) continue;
+			row_parts[r][c / square_width] |= g.cand[r * side_len + c];
+			col_parts[c][r / square_height] |= g.cand[r * side_len + c];
+		}
+	}
+
+	// Numbers of a row confined to one square, numbers of a square confined to one row
+	for (sudoku_size_t r = 0; r < side_len; ++r) {
+		const sudoku_size_t sq_row = r / square_height;
+		for (sudoku_size_t sq_col = 0; sq_col < n_square_cols; ++sq_col) {
+			const cand_mask_t set_in_square = set_in[2 * side_len + sq_row * n_square_cols + sq_col];
+			cand_mask_t in_row = 0;
+			for (sudoku_size_t k = 0; k < n_square_cols; ++k) {
+				if (k != sq_col) in_row |= row_parts[r][k];
+			}
+			cand_mask_t in_square = 0;
+			for (sudoku_size_t k = sq_row * square_height; k < (sq_row + 1) * square_height; ++k) {
+				if (k != r) in_square |= row_parts[k][sq_col];
+			}
+			const cand_mask_t claimed = row_parts[r][sq_col] & (cand_mask_t)~in_row & (cand_mask_t)~set_in[r];
+			const cand_mask_t pointing = row_parts[r][sq_col] & (cand_mask_t)~in_square & (cand_mask_t)~set_in_square;
+			if ((claimed & in_square) || (pointing & in_row)) return true;
+		}
+	}
+
+	// Numbers of a col confined to one square, numbers of a square confined to one col
+	for (sudoku_size_t c = 0; c < side_len; ++c) {
+		const sudoku_size_t sq_col = c / square_width;
+		for (sudoku_size_t sq_row = 0; sq_row < n_square_rows; ++sq_row) {
+			const cand_mask_t set_in_square = set_in[2 * side_len + sq_row * n_square_cols + sq_col];
+			cand_mask_t in_col = 0;
+			for (sudoku_size_t k = 0; k < n_square_rows; ++k) {
+				if (k != sq_row) in_col |= col_parts[c][k];
+			}
+			cand_mask_t in_square = 0;
+			for (sudoku_size_t k = sq_col * square_width; k < (sq_col + 1) * square_width; ++k) {
+				if (k != c) in_square |= col_parts[k][sq_row];
+			}
+			const cand_mask_t claimed = col_parts[c][sq_row] & (cand_mask_t)~in_col & (cand_mask_t)~set_in[side_len + c];
+			const cand_mask_t pointing = col_parts[c][sq_row] & (cand_mask_t)~in_square & (cand_mask_t)~set_in_square;
+			if ((claimed & in_square) || (pointing & in_col)) return true;
+		}
+	}
+	return false;
+}
+
+// Like grade_rec_depth_path() with the full propagation, but on the candidates
+// If the first round of try_solving() changes nothing, it only removes the
+// set numbers from their peers. Otherwise it stops at the same candidates
+// as propagate_cand_grid(). The cell is picked like find_least_uncertain_cell().
+inline rec_depth_t grade_cand_grid_path(CandSearchGrid & g, const raw_sudoku_t & sol) {
+	const SudokuUnits & units = get_units();
+	for (rec_depth_t rec_dep = 0; ; ++rec_dep) {
+		if (cand_grid_round_changes(g)) {
+			if (!propagate_cand_grid(g)) {
+				return -2;
+			}
+		}
+		else {
+			for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+				if (!g.set[c] || g.placed[c]) continue;
+				g.placed[c] = true;
+				for (const sudoku_size_t p : units.peers[c]) {
+					if (!g.set[p]) g.cand[p] &= (cand_mask_t)~g.cand[c];
+				}
+			}
+		}
+
+		sudoku_size_t cell_picked = tot_num_cells;
+		int min_cands = side_len + 1;
+		for (sudoku_size_t row_num = 0; row_num < side_len; ++row_num) {
+			for (sudoku_size_t col_num = 0; col_num < side_len; ++col_num) {
+				const sudoku_size_t c = row_num + col_num * side_len;
+				const int n = count_cands(g.cand[c]);
+				if (!g.set[c] && n < min_cands) {
+					min_cands = n;
+					cell_picked = c;
+				}
+			}
+		}
+		if (cell_picked == tot_num_cells) {
+			return rec_dep;
+		}
+		if (min_cands == 0) {
+			return -2;
+		}
+		g.cand[cell_picked] = (cand_mask_t)(1 << (sol[cell_picked] - 1));
+		g.set[cell_picked] = true;
+	}
+}
+
+// Find the level like solve_count_rec_depth(), with the same return codes
+// The solutions are counted on candidate bitmasks. If the solution is
+// unique, every branch of solve_count_rec_depth() without it has no
+// solution, so the level is the depth at which its search sets the
+// solution. Only that path is followed. Without an active profile it is
+// followed on the candidates as well, see propagate_cand_grid(), otherwise
+// with the propagation of the profile.
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
+rec_depth_t grade_rec_depth(sudoku_data_t & s_data, SearchBudget * budget = nullptr) {
+
+	CandSearchGrid g = to_cand_search_grid(s_data);
+	CandSearchGrid g_root = g;
+	int n_sols = 0;
+	raw_sudoku_t sol;
+	if (!search_cand_grid(g, 2, n_sols, sol, budget)) {
+		return budget->cancelled ? -5 : -4;
+	}
+	if (n_sols == 0) {
+		return -2;
+	}
+	if (n_sols > 1) {
+		return -1;
+	}
+	if constexpr (printDebugInfo) std::cout << "Unique solution found.\n";
+	if (active_profile() != nullptr) {
+		return grade_rec_depth_path<square_height, square_width>(s_data, sol, 0);
+	}
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		s_data[c * n_stored_per_cell] = sol[c];
+	}
+	return grade_cand_grid_path(g_root, sol);
+}
+
+// Counts the number that is currently set in the given sudoku
+sudoku_size_t count_num_known_numbers(const sudoku_data_t & s_data) {
+
+	sudoku_size_t num_ct = 0;
+
+	// Iterate over all rows 
+	for (sudoku_size_t row_num = 0; row_num < side_len; ++row_num) {
 
 		// Check if number already set somewhere
 		for (sudoku_size_t col_num = 0; col_num < side_len; ++col_num) {
@@ -1324,6 +3564,79 @@ void remove_nth(sudoku_data_t & s_data, const sudoku_size_t n) {
 	std::cout << "Fucking index too high :(\n";
 }
 
+/// Symmetry of the clue pattern of generated sudokus.
+enum SudokuSymmetry {
+	NoSymmetry, ///< Clues are removed cell by cell.
+	RotationalSymmetry, ///< Pattern is invariant under a rotation by 180 degrees.
+	DiagonalSymmetry, ///< Pattern is invariant under reflection on the main diagonal.
+	MirrorSymmetry, ///< Pattern is invariant under reflection on the vertical center line.
+};
+
+/// String array mapping each \ref SudokuSymmetry to an informative string.
+const std::string sud_sym_msgs[] = { "No symmetry.", "180 degree rotational symmetry.",
+	"Diagonal symmetry.", "Vertical mirror symmetry." };
+
+/// Printing \ref SudokuSymmetry to std::cout.
+inline std::ostream& operator<<(std::ostream & os, const SudokuSymmetry & sym) {
+	os << sud_sym_msgs[sym] << "\n";
+	return os;
+}
+
+/// Returns the cell that 'cell_ind' is mapped to by the symmetry 'sym'.
+inline sudoku_size_t symmetric_cell(const sudoku_size_t cell_ind, const SudokuSymmetry sym) {
+	const sudoku_size_t row_ind = cell_ind / side_len;
+	const sudoku_size_t col_ind = cell_ind % side_len;
+	switch (sym) {
+	case RotationalSymmetry:
+		return tot_num_cells - 1 - cell_ind;
+	case DiagonalSymmetry:
+		return col_ind * side_len + row_ind;
+	case MirrorSymmetry:
+		return row_ind * side_len + side_len - 1 - col_ind;
+	default:
+		return cell_ind;
+	}
+}
+
+/// Returns one representative cell per orbit of the symmetry 'sym'.
+///
+/// All symmetries are involutions, so each orbit consists of
+/// the representative and its image under \ref symmetric_cell().
+inline std::vector<sudoku_size_t> get_orbit_representatives(const SudokuSymmetry sym) {
+	std::vector<sudoku_size_t> reps;
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		if (i <= symmetric_cell(i, sym)) {
+			reps.push_back(i);
+		}
+	}
+	return reps;
+}
+
+/// Removes the numbers in the orbit of 'cell_ind' and returns how many were removed.
+inline sudoku_size_t remove_orbit(sudoku_data_t & s_data, const sudoku_size_t cell_ind, const SudokuSymmetry sym) {
+	sudoku_size_t n_removed = 0;
+	const sudoku_size_t partner_ind = symmetric_cell(cell_ind, sym);
+	if (s_data[cell_ind * n_stored_per_cell] > 0) {
+		s_data[cell_ind * n_stored_per_cell] = 0;
+		++n_removed;
+	}
+	if (partner_ind != cell_ind && s_data[partner_ind * n_stored_per_cell] > 0) {
+		s_data[partner_ind * n_stored_per_cell] = 0;
+		++n_removed;
+	}
+	return n_removed;
+}
+
+/// Checks if the pattern of set numbers of 's' is invariant under 'sym'.
+inline bool has_symmetry(const raw_sudoku_t & s, const SudokuSymmetry sym) {
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		if ((s[i] > 0) != (s[symmetric_cell(i, sym)] > 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 // Generates a string that describes the sudoku.
 // First number:			Difficulty level {0, ... , 9}
 // First 2 numbers:			# Filled-in digits 
@@ -1362,49 +3675,212 @@ sud_char_t generate_sud_char(const raw_sudoku_t & s, const rec_depth_t lvl) {
 }
 
 // Adds the sudoku 's' and its solution 's_sol' in raw form to the collection
-// 'sud_map' if there are less than 'max_sud_per_key' sudokus already there.
+// 'sud_map' if it is not there yet and there are less than 'max_sud_per_key'
+// sudokus with the same description already there.
 bool add_to_coll(sud_coll_t & sud_map, const sud_char_t & desc, const raw_sudoku_t s, const raw_sudoku_t s_sol, const num_sud_t max_sud_per_key = 100) {
+	return sud_map.add(desc, s, s_sol, max_sud_per_key);
+}
 
-	const sud_and_sol_t s_and_sol = std::make_pair(s, s_sol);
-	const auto pos = sud_map.find(desc);
-	if (pos == sud_map.end()) {
-		std::vector<sud_and_sol_t> val;
-		val.push_back(s_and_sol);
-		sud_map[desc] = val;
-		return true;
+/// Converts a raw sudoku to a string.
+///
+/// Does the opposite of \ref string_to_sud().
+std::string sud_to_string(const raw_sudoku_t & s) {
+	std::string res;
+	res.reserve(3 * tot_num_cells);
+	for (sudoku_size_t i = 0; i < side_len * side_len; ++i) {
+		if (s[i] >= 10) {
+			res += (char)('0' + s[i] / 10);
+		}
+		res += (char)('0' + s[i] % 10);
+		res += ' ';
 	}
-	else {
-		std::vector<sud_and_sol_t> & val = sud_map[desc];
-		if (val.size() > max_sud_per_key) {
-			return false;
+	return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parsing Sudoku Files
+//
+// Two line formats are understood:
+// Collection format:	Description (see \ref generate_sud_char()), the sudoku
+//						and its solution as numbers separated by spaces, like
+//						in 'example_data.txt'.
+// One-line format:		side_len * side_len characters, '1' - '9' for set
+//						numbers and '0' or '.' for empty cells.
+// The parser works directly on the character buffer and does not allocate.
+
+/// Format of a parsed line.
+enum SudokuLineFormat {
+	InvalidLineFormat, ///< Line could not be parsed.
+	CollLineFormat, ///< Description, sudoku and solution.
+	OneLineFormat, ///< Only the sudoku as characters.
+};
+
+/// Maximum length of a description.
+constexpr std::size_t max_desc_len = 16;
+
+/// Result of parsing one line.
+struct ParsedSudokuLine {
+	SudokuLineFormat format; ///< The format of the line.
+	std::array<char, max_desc_len> desc; ///< Description, only in collection format.
+	std::size_t desc_len; ///< Length of description.
+	raw_sudoku_t sud; ///< The sudoku.
+	raw_sudoku_t sol; ///< The solution, only in collection format.
+
+	/// Returns the description as string.
+	sud_char_t get_desc() const {
+		return sud_char_t(desc.data(), desc_len);
+	}
+};
+
+/// Parses 'tot_num_cells' numbers separated by spaces starting at 'p'.
+///
+/// Returns the position after the last number or nullptr if the numbers
+/// are invalid. If 'filled' is true, empty cells are invalid.
+inline const char * parse_sudoku_numbers(const char * p, const char * end, raw_sudoku_t & s, const bool filled) {
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		while (p < end && *p == ' ') {
+			++p;
 		}
-		else {
-			sud_map[desc].push_back(s_and_sol);
+		if (p == end || *p < '0' || *p > '9') {
+			return nullptr;
+		}
+		sudoku_value_t v = *p++ - '0';
+		while (p < end && *p >= '0' && *p <= '9' && v <= side_len) {
+			v = 10 * v + (*p++ - '0');
+		}
+		if (v > side_len || (filled && v == 0)) {
+			return nullptr;
+		}
+		s[i] = v;
+	}
+	return p;
+}
+
+/// Parses the line [beg, end) without the line break.
+inline bool parse_sudoku_line(const char * beg, const char * end, ParsedSudokuLine & res) {
+	res.format = InvalidLineFormat;
+	if (end > beg && end[-1] == '\r') {
+		--end;
+	}
+	const std::size_t len = (std::size_t)(end - beg);
+
+	// One-line format
+	if (len >= (std::size_t)tot_num_cells && (len == (std::size_t)tot_num_cells || beg[tot_num_cells] == ' ' || beg[tot_num_cells] == '\t')) {
+		bool valid = side_len < 10;
+		for (sudoku_size_t i = 0; i < tot_num_cells && valid; ++i) {
+			const char c = beg[i];
+			if (c == '.') {
+				res.sud[i] = 0;
+			}
+			else if (c >= '0' && c <= '0' + side_len) {
+				res.sud[i] = c - '0';
+			}
+			else {
+				valid = false;
+			}
+		}
+		if (valid) {
+			res.format = OneLineFormat;
+			res.desc_len = 0;
 			return true;
 		}
 	}
-	return false;
+
+	// Collection format, description first
+	const char * p = beg;
+	while (p < end && *p >= '0' && *p <= '9') {
+		++p;
+	}
+	res.desc_len = (std::size_t)(p - beg);
+	if (res.desc_len == 0 || res.desc_len > max_desc_len || p == end || *p != ' ') {
+		return false;
+	}
+	std::copy(beg, p, res.desc.begin());
+	p = parse_sudoku_numbers(p, end, res.sud, false);
+	if (p == nullptr) {
+		return false;
+	}
+	p = parse_sudoku_numbers(p, end, res.sol, true);
+	if (p == nullptr) {
+		return false;
+	}
+	res.format = CollLineFormat;
+	return true;
 }
 
-/// Converts a raw sudoku to a string.
+/// Parses all complete lines in the buffer [data, data + n).
 ///
-/// Does the opposite of \ref string_to_sud().
-std::string sud_to_string(const raw_sudoku_t & s) {
-	std::string res = "";
-	for (sudoku_size_t i = 0; i < side_len * side_len; ++i) {
-		res += std::to_string(s[i]) + " ";
+/// Calls 'f(const ParsedSudokuLine &)' for each valid line. Returns the
+/// number of bytes consumed, an incomplete last line is not consumed unless
+/// 'is_last' is true. The number of invalid non-empty lines is added to 'n_invalid'.
+template<class Func>
+std::size_t parse_sudoku_buffer(const char * data, const std::size_t n, Func && f, std::size_t & n_invalid, const bool is_last = true) {
+	ParsedSudokuLine line;
+	const char * p = data;
+	const char * end = data + n;
+	while (p < end) {
+		const char * nl = static_cast<const char *>(std::memchr(p, '\n', (std::size_t)(end - p)));
+		if (nl == nullptr && !is_last) {
+			break;
+		}
+		const char * line_end = nl == nullptr ? end : nl;
+		if (line_end > p && !(line_end == p + 1 && *p == '\r')) {
+			if (parse_sudoku_line(p, line_end, line)) {
+				f(line);
+			}
+			else {
+				++n_invalid;
+			}
+		}
+		p = nl == nullptr ? end : nl + 1;
 	}
-	return res;
+	return (std::size_t)(p - data);
+}
+
+/// Parses the file 'f_path' in large chunks, see \ref parse_sudoku_buffer().
+///
+/// The number of invalid lines is added to 'n_invalid'. Returns false if
+/// the file could not be opened or read.
+template<class Func>
+bool parse_sudoku_file(const std::string & f_path, Func && f, std::size_t & n_invalid, const std::size_t chunk_size = 1 << 22) {
+	std::ifstream file(f_path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::vector<char> buf(chunk_size);
+	std::size_t n_buf = 0;
+	while (file) {
+		// Grow the buffer if a single line does not fit
+		if (n_buf == buf.size()) {
+			buf.resize(2 * buf.size());
+		}
+		file.read(buf.data() + n_buf, (std::streamsize)(buf.size() - n_buf));
+		n_buf += (std::size_t)file.gcount();
+		const bool is_last = !file;
+		const std::size_t n_used = parse_sudoku_buffer(buf.data(), n_buf, f, n_invalid, is_last);
+		std::copy(buf.begin() + n_used, buf.begin() + n_buf, buf.begin());
+		n_buf -= n_used;
+	}
+	return !file.bad();
 }
 
 /// Convert String to Sudoku.
 ///
-/// Does the opposite of \ref sud_to_string().
+/// Does the opposite of \ref sud_to_string(). Returns false if 'str' does
+/// not contain a valid sudoku, 's' is empty then.
+inline bool string_to_sud(const std::string & str, raw_sudoku_t & s) {
+	if (parse_sudoku_numbers(str.data(), str.data() + str.size(), s, false) == nullptr) {
+		std::fill(s.begin(), s.end(), 0);
+		return false;
+	}
+	return true;
+}
+
+/// Convert String to Sudoku, returns an empty sudoku if 'str' is invalid.
 raw_sudoku_t string_to_sud(const std::string & str) {	
 	raw_sudoku_t rs;
-	for (sudoku_size_t i = 0; i < side_len * side_len; ++i) {
-		const std::string num_str = str.substr(2 * i, 2 * i + 1);
-		rs[i] = std::stoi(num_str);
+	if (!string_to_sud(str, rs)) {
+		std::cout << "Invalid sudoku: " << str << "\n";
 	}
 	return rs;
 }
@@ -1412,21 +3888,20 @@ raw_sudoku_t string_to_sud(const std::string & str) {
 std::string file_dir = "./Data/";
 std::string file_path = file_dir + "dat.txt";
 
-/// Saves the collection in text format.
-void save_coll(const sud_coll_t & sud_map, std::string folder_path = file_path) {
+/// Saves the collection in text format, returns false if writing failed.
+bool save_coll(const sud_coll_t & sud_map, std::string folder_path = file_path) {
 
 	std::ofstream myfile;
 	myfile.open(folder_path);
-	for (auto& x : sud_map)
+	for (auto& desc : sud_map.get_sorted_descs())
 	{
-		const sud_char_t & desc = x.first;
-		const std::vector<sud_and_sol_t> sas = x.second;
-		for (auto& e : sas) {
-			const auto&[s, sol] = e;
+		for (const auto ind : sud_map.with_desc(desc)) {
+			const auto[s, sol] = sud_map.get(ind);
 			myfile << desc << " " << sud_to_string(s) << sud_to_string(sol) << "\n";
 		}
 	}
 	myfile.close();
+	return (bool)myfile;
 }
 
 /// Checks if file 'name' exists.
@@ -1437,67 +3912,317 @@ inline bool f_exists(const std::string & f_name) {
 
 #include<sstream>
 
+/// Path of the journal that belongs to the collection file 'f_path'.
+inline std::string journal_path(const std::string & f_path) {
+	return f_path + ".journal";
+}
+
+/// Reads the sudokus in the text file 'f_path' into the collection.
+///
+/// Incomplete lines, e.g. from a crash while appending to a journal,
+/// are skipped. Returns the number of lines that were not added.
+inline std::size_t load_coll_file(sud_coll_t & sud_map, const std::string & f_path) {
+
+	std::size_t n_rejected = 0;
+	const bool read = parse_sudoku_file(f_path, [&](const ParsedSudokuLine & line) {
+		if (line.format != CollLineFormat || !add_to_coll(sud_map, line.get_desc(), line.sud, line.sol)) {
+			++n_rejected;
+		}
+	}, n_rejected);
+	if (!read) {
+		std::cout << "Could not read " << f_path << "\n";
+	}
+	return n_rejected;
+}
+
 // Load the sudokus saved on disk into collection
+//
+// Reads the snapshot 'folder_path' and replays its journal on top of it.
 sud_coll_t load_coll(std::string folder_path = file_path) {
 	sud_coll_t sud_map;
 
 	// Return empty map if file does not exist
-	if (!f_exists(folder_path)) {
+	const std::string j_path = journal_path(folder_path);
+	if (!f_exists(folder_path) && !f_exists(j_path)) {
 		std::cout << "Creating new file\n";
 		return sud_map;
 	}
 
-	// Read file linewise and extract info
-	std::ifstream file(folder_path);
-	std::string str;
-	while (std::getline(file, str)) {
-		const std::string desc = str.substr(0, 12);
-		const sudoku_size_t s_end = 13 + 2 * side_len * side_len;
-		const std::string s_str = str.substr(13, s_end);
-		const std::string s_sol_str = str.substr(s_end, s_end + 2 * side_len * side_len);
-		const raw_sudoku_t s = string_to_sud(s_str);
-		const raw_sudoku_t s_sol = string_to_sud(s_sol_str);
-		const bool tr = add_to_coll(sud_map, desc, s, s_sol);
-		if (tr == false) {
-			std::cout << "Fucking Error Ocurred!!!!!!!!!\n\n\n\n";
-		}
+	std::size_t n_rejected = 0;
+	if (f_exists(folder_path)) {
+		n_rejected += load_coll_file(sud_map, folder_path);
+	}
+	if (f_exists(j_path)) {
+		n_rejected += load_coll_file(sud_map, j_path);
+	}
+	if (n_rejected > 0) {
+		std::cout << "Skipped " << n_rejected << " duplicate or incomplete Sudokus.\n";
 	}
 	return sud_map;
 }
 
+/// Append-only journal of a collection file.
+///
+/// New sudokus are collected in memory and written in batches by a background
+/// thread, in the same text format as \ref save_coll(). The file is synced to
+/// disk at most every 'sync_interval' and when the journal is flushed or destroyed.
+/// A crash can therefore only lose the last unsynced batch, \ref load_coll()
+/// replays the journal and skips a partially written last line.
+class CollJournal {
+
+public:
+	/// Opens the journal of the collection file 'f_path' for appending.
+	CollJournal(const std::string & f_path = file_path, const std::size_t batch_size = 64,
+		const std::chrono::milliseconds sync_interval = std::chrono::milliseconds(5000))
+		: batch_size(batch_size), sync_interval(sync_interval) {
+#ifdef _WIN32
+		fd = _open(journal_path(f_path).c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+		fd = ::open(journal_path(f_path).c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+		if (fd < 0) {
+			std::cout << "Could not open journal of " << f_path << "\n";
+			return;
+		}
+		writer = std::thread(&CollJournal::write_loop, this);
+	}
+
+	CollJournal(const CollJournal &) = delete;
+	CollJournal & operator=(const CollJournal &) = delete;
+
+	/// Writes and syncs everything and closes the journal.
+	~CollJournal() {
+		if (fd < 0) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		work_cv.notify_one();
+		writer.join();
+#ifdef _WIN32
+		_close(fd);
+#else
+		::close(fd);
+#endif
+	}
+
+	/// True if the journal file could be opened.
+	bool is_open() const {
+		return fd >= 0;
+	}
+
+	/// Appends a sudoku and its solution, does not block on I/O.
+	///
+	/// Returns false and drops the sudoku if the journal is not open.
+	bool append(const sud_char_t & desc, const raw_sudoku_t & s, const raw_sudoku_t & s_sol) {
+		if (fd < 0) {
+			return false;
+		}
+		const std::string line = desc + " " + sud_to_string(s) + sud_to_string(s_sol) + "\n";
+		bool notify = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pending += line;
+			++n_appended;
+			notify = n_appended - n_written >= batch_size;
+		}
+		if (notify) {
+			work_cv.notify_one();
+		}
+		return true;
+	}
+
+	/// Blocks until everything appended so far is written and synced.
+	void flush() {
+		std::unique_lock<std::mutex> lock(mtx);
+		const std::uint64_t target = n_appended;
+		flush_requested = true;
+		work_cv.notify_one();
+		synced_cv.wait(lock, [&]() { return n_durable >= target || fd < 0; });
+	}
+
+private:
+	/// Background thread: writes batches and syncs.
+	void write_loop() {
+		auto last_sync = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			work_cv.wait_for(lock, sync_interval, [&]() {
+				return stop || flush_requested || n_appended - n_written >= batch_size;
+			});
+			std::string batch;
+			batch.swap(pending);
+			const std::uint64_t batch_end = n_appended;
+			const bool force_sync = stop || flush_requested;
+			flush_requested = false;
+			lock.unlock();
+
+			// Write outside of the lock
+			write_all(batch);
+			const auto now = std::chrono::steady_clock::now();
+			const bool synced = force_sync || now - last_sync >= sync_interval;
+			if (synced) {
+				sync();
+				last_sync = now;
+			}
+
+			lock.lock();
+			n_written = batch_end;
+			if (synced) {
+				n_durable = batch_end;
+				synced_cv.notify_all();
+			}
+			if (stop && pending.empty()) {
+				return;
+			}
+		}
+	}
+
+	/// Writes the whole buffer.
+	void write_all(const std::string & buf) {
+		std::size_t n_written = 0;
+		while (n_written < buf.size()) {
+#ifdef _WIN32
+			const int n = _write(fd, buf.data() + n_written, (unsigned int)(buf.size() - n_written));
+#else
+			const ssize_t n = ::write(fd, buf.data() + n_written, buf.size() - n_written);
+#endif
+			if (n <= 0) {
+				std::cout << "Writing to journal failed!\n";
+				return;
+			}
+			n_written += (std::size_t)n;
+		}
+	}
+
+	/// Syncs the file to disk.
+	void sync() {
+#ifdef _WIN32
+		_commit(fd);
+#else
+		fsync(fd);
+#endif
+	}
+
+	const std::size_t batch_size;
+	const std::chrono::milliseconds sync_interval;
+	int fd = -1;
+
+	std::mutex mtx;
+	std::condition_variable work_cv;
+	std::condition_variable synced_cv;
+	std::string pending;
+	std::uint64_t n_appended = 0;
+	std::uint64_t n_written = 0; ///< Number of appended sudokus written.
+	std::uint64_t n_durable = 0; ///< Number of appended sudokus written and synced.
+	bool flush_requested = false;
+	bool stop = false;
+	std::thread writer;
+};
+
+/// Syncs the file 'f_path' to disk, returns false on failure.
+inline bool sync_file(const std::string & f_path) {
+#ifdef _WIN32
+	const int fd = _open(f_path.c_str(), _O_RDWR | _O_BINARY);
+	if (fd < 0) {
+		return false;
+	}
+	const bool ok = _commit(fd) == 0;
+	_close(fd);
+#else
+	const int fd = ::open(f_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	const bool ok = fsync(fd) == 0;
+	::close(fd);
+#endif
+	return ok;
+}
+
+/// Atomically replaces the file 'to' by the file 'from', returns false on failure.
+///
+/// 'to' is never removed first, after a crash it is either the old or the new file.
+inline bool replace_file(const std::string & from, const std::string & to) {
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	if (std::rename(from.c_str(), to.c_str()) != 0) {
+		return false;
+	}
+
+	// Sync the directory, so the rename itself is durable
+	const std::size_t slash = to.find_last_of('/');
+	const std::string dir = slash == std::string::npos ? "." : to.substr(0, slash + 1);
+	const int dir_fd = ::open(dir.c_str(), O_RDONLY);
+	if (dir_fd >= 0) {
+		fsync(dir_fd);
+		::close(dir_fd);
+	}
+	return true;
+#endif
+}
+
+/// Merges the journal into the collection file and empties the journal.
+///
+/// The merged collection is written to a temporary file, synced and renamed
+/// over the collection file, so a crash never loses the collection. Must not
+/// run while a \ref CollJournal of the same file is open.
+inline void compact_coll(const std::string & f_path = file_path) {
+	const sud_coll_t sud_map = load_coll(f_path);
+	const std::string tmp_path = f_path + ".tmp";
+	if (!save_coll(sud_map, tmp_path) || !sync_file(tmp_path)) {
+		std::cout << "Could not write " << tmp_path << "\n";
+		std::remove(tmp_path.c_str());
+		return;
+	}
+	if (!replace_file(tmp_path, f_path)) {
+		std::cout << "Could not replace " << f_path << "\n";
+		return;
+	}
+	std::ofstream(journal_path(f_path), std::ios::trunc);
+}
+
 // Separate Sudokus into separate maps by difficulty
 void separate_by_level_and_save(const sud_coll_t & sud_map) {
 
 	const rec_depth_t max_lvl = 9;
-	std::array<sud_coll_t, max_lvl> lvl_sep_map;
 
-	for (auto& x : sud_map)
-	{
-		// Find Level
-		const sud_char_t & desc = x.first;
-		const std::vector<sud_and_sol_t> sas = x.second;
-		const std::string lvl_string = desc.substr(0, 1);
-		const rec_depth_t lvl = std::stoi(lvl_string);
+	for (rec_depth_t i = 0; i < max_lvl; ++i) {
 
-		// Add to collection
-		lvl_sep_map[lvl][desc] = sas;
-	}
+		// Collect the sudokus of this level
+		sud_coll_t lvl_sep_map;
+		const auto& lvl_inds = sud_map.with_level(i);
+		lvl_sep_map.reserve(lvl_inds.size());
+		for (const auto ind : lvl_inds) {
+			const auto[s, sol] = sud_map.get(ind);
+			lvl_sep_map.add(sud_map.get_desc(ind), s, sol, std::numeric_limits<num_sud_t>::max());
+		}
 
-	// Save to separate files
-	for (rec_depth_t i = 0; i < max_lvl; ++i) {
+		// Save to separate file
 		std::string f_name = file_dir + "ext_lvl_" + std::to_string(i) + ".txt";
-		save_coll(lvl_sep_map[i], f_name);
+		save_coll(lvl_sep_map, f_name);
 	}
 }
 
 /// Generate hard Sudokus and save them to the disk.
-void generate_hard_sudokus(const num_sud_t max_suds_per_lvl = 1000) {
+///
+/// If 'sym' is not \ref NoSymmetry, the numbers are removed orbit by orbit
+/// so that the clue pattern of every generated sudoku has that symmetry.
+void generate_hard_sudokus(const num_sud_t max_suds_per_lvl = 1000, const SudokuSymmetry sym = NoSymmetry) {
 
 	// Initialize
 	std::array<sudoku_value_t, side_len> lvl_count;
 	std::fill(lvl_count.begin(), lvl_count.end(), 0);
 	sud_coll_t sud_map = load_coll();
+	CollJournal journal;
+	if (!journal.is_open()) {
+		std::cout << "Generated sudokus are not saved!\n";
+	}
 	std::mt19937 gen = std::mt19937(seed);
+	std::vector<sudoku_size_t> orbit_order = get_orbit_representatives(sym);
 
 	for (int k = 0; k < 50000; ++k) {
 
@@ -1523,29 +4248,28 @@ void generate_hard_sudokus(const num_sud_t max_suds_per_lvl = 1000) {
 		for (int l = 0; l < 100; ++l) {
 			sudoku = sudoku_solution_copy;
 
-			// Remove digits randomly
+			// Remove digits randomly, one symmetry orbit at a time
+			std::shuffle(orbit_order.begin(), orbit_order.end(), gen);
+			std::size_t orbit_ind = 0;
 			const sudoku_size_t n_init = 45;
-			for (sudoku_size_t i = 0; i < n_init; ++i) {
-				sudoku_size_t remove_ind = std::rand() % (tot_num_cells - i);
-				remove_nth(sudoku, remove_ind);
+			sudoku_size_t n_curr = 0;
+			while (n_curr < n_init && orbit_ind < orbit_order.size()) {
+				n_curr += remove_orbit(sudoku, orbit_order[orbit_ind++], sym);
 			}
 			auto_fill(sudoku, true);
 			sudoku_data_t sudoku_copy = sudoku;
 
 			// Remove more, untill multiple solutions possible
-			sudoku_size_t n_curr = n_init;
 			bool unique_sol_exists = true;
-			while (unique_sol_exists) {
+			while (unique_sol_exists && orbit_ind < orbit_order.size()) {
 
-				// Remove one digit
-				sudoku_size_t remove_ind = std::rand() % (tot_num_cells - n_curr);
-				remove_nth(sudoku, remove_ind);
+				// Remove one orbit, the uniqueness is only checked once per orbit
+				n_curr += remove_orbit(sudoku, orbit_order[orbit_ind++], sym);
 				auto_fill(sudoku, true);
 				sudoku_copy = sudoku;
-				++n_curr;
 
 				// Try solving
-				rec_depth_t rec_dep = solve_count_rec_depth<3, 3>(sudoku_copy);
+				rec_depth_t rec_dep = grade_rec_depth<3, 3>(sudoku_copy);
 				if (rec_dep > 3) {
 					const sudoku_size_t n_sud_w_lvl = lvl_count[rec_dep];
 					if (n_sud_w_lvl < max_suds_per_lvl) {
@@ -1553,6 +4277,7 @@ void generate_hard_sudokus(const num_sud_t max_suds_per_lvl = 1000) {
 						const sud_char_t desc = generate_sud_char(raw_sud, rec_dep);
 						bool added = add_to_coll(sud_map, desc, raw_sud, raw_s_sol);
 						if (added) {
+							journal.append(desc, raw_sud, raw_s_sol);
 							std::cout << "Added hard Sudoku :D, level: " << rec_dep;
 							std::cout << ", With ID: " << desc << "\n";
 							lvl_count[rec_dep]++;
@@ -1566,9 +4291,9 @@ void generate_hard_sudokus(const num_sud_t max_suds_per_lvl = 1000) {
 			}			
 		}
 		if ((k + 1) % 200 == 0) {
-			std::cout << "Iteration: " << k + 1 << ", Saving...\n";
-			save_coll(sud_map);
+			std::cout << "Iteration: " << k + 1 << ", Collection size: " << sud_map.size() << "\n";
 		}
 	}
+	journal.flush();
 	std::cout << "Finished!\n";
 }
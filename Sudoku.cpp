@@ -3,16 +3,220 @@
 
 #include "pch.h"
 #include "Lib.h"
+#include "sudoku_stream.h"
+#include "sudoku_bench.h"
+#include "sudoku_grader.h"
+#include "sudoku_band_count.h"
 
 #include <string>
 #include <iostream>
 #include <random>
 
+/// Sudokus with a known number of solutions, see \ref run_check().
+const raw_sudoku_t only_53_solutions_sudoku_3x3 = {
+	5,0,0,0,0,0,0,0,7,
+	0,0,0,4,6,2,0,0,1,
+	0,0,0,1,0,0,3,4,0,
+	0,0,0,0,4,0,1,0,0,
+	0,0,0,2,0,6,0,0,0,
+	0,0,8,0,3,0,0,0,0,
+	0,5,1,0,0,4,0,0,0,
+	2,0,0,0,8,7,0,0,0,
+	9,0,0,0,0,0,0,0,8
+};
+const raw_sudoku_t many_11199_solutions_sudoku_3x3 = {
+	5,0,0,0,0,0,0,0,7,
+	0,0,0,4,0,2,0,0,1,
+	0,0,0,1,0,0,0,4,0,
+	0,0,0,0,4,0,1,0,0,
+	0,0,0,0,0,6,0,0,0,
+	0,0,8,0,3,0,0,0,0,
+	0,5,1,0,0,4,0,0,0,
+	2,0,0,5,8,7,0,0,0,
+	9,0,0,0,0,0,0,0,8
+};
+const raw_sudoku_t many_177859_solutions_sudoku_3x3 = {
+	5,0,0,0,0,0,0,0,7,
+	0,0,0,4,0,2,0,0,1,
+	0,0,0,1,0,0,0,4,0,
+	0,0,0,0,4,0,1,0,0,
+	0,0,0,0,0,6,0,0,0,
+	0,0,8,0,3,0,0,0,0,
+	0,5,0,0,0,4,0,0,0,
+	2,0,0,0,8,7,0,0,0,
+	9,0,0,0,0,0,0,0,8
+};
+
+/// Solves the sudokus from a file or stdin and writes the solutions to stdout.
+///
+/// Usage: Sudoku --batch [file|-] [--threads n] [--max-nodes n] [--timeout-ms t]
+int run_batch(int argc, char* argv[]) {
+	std::string in_path = "-";
+	unsigned int n_threads = default_num_threads();
+	SearchLimits limits;
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			n_threads = (unsigned int)std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--max-nodes" && i + 1 < argc) {
+			limits.max_nodes = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--timeout-ms" && i + 1 < argc) {
+			limits.timeout = std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+		}
+		else {
+			in_path = arg;
+		}
+	}
+
+	std::ios::sync_with_stdio(false);
+	StreamSolveStats stats;
+	if (in_path == "-") {
+		stats = solve_stream(std::cin, std::cout, n_threads, limits);
+	}
+	else {
+		std::ifstream in(in_path, std::ios::binary);
+		if (!in) {
+			std::cerr << "Could not open " << in_path << "\n";
+			return 1;
+		}
+		stats = solve_stream(in, std::cout, n_threads, limits);
+	}
+	std::cerr << stats;
+	return 0;
+}
+
+/// Benchmarks the solvers on a collection file, see \ref run_benchmark().
+///
+/// Usage: Sudoku --bench file [repeats]
+int run_bench(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: Sudoku --bench file [repeats]\n";
+		return 1;
+	}
+	const int n_repeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 1;
+	const sud_coll_t sud_map = load_coll(argv[2]);
+	std::cout << run_benchmark(sud_map, default_bench_engines(), n_repeats);
+	return 0;
+}
+
+/// Grades the sudokus of a file with human techniques, see \ref grade_sudoku().
+///
+/// Writes 'status,rating,hardest' per sudoku to stdout and the statistics
+/// to stderr.
+///
+/// Usage: Sudoku --grade file [--threads n]
+int run_grade(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: Sudoku --grade file [--threads n]\n";
+		return 1;
+	}
+	unsigned int n_threads = default_num_threads();
+	if (argc > 4 && std::string(argv[3]) == "--threads") {
+		n_threads = (unsigned int)std::max(1, std::atoi(argv[4]));
+	}
+	std::vector<raw_sudoku_t> suds;
+	std::size_t n_invalid = 0;
+	const bool read = parse_sudoku_file(argv[2], [&](const ParsedSudokuLine & line) {
+		suds.push_back(line.sud);
+	}, n_invalid);
+	if (!read) {
+		std::cerr << "Could not read " << argv[2] << "\n";
+		return 1;
+	}
+	if (n_invalid > 0) {
+		std::cerr << "Skipped " << n_invalid << " invalid lines\n";
+	}
+
+	WorkStealingPool pool(n_threads);
+	std::vector<GradeResult> results(suds.size());
+	const GradeStats stats = grade_batch(pool, suds.data(), suds.size(), results.data());
+	std::ios::sync_with_stdio(false);
+	for (const auto& res : results) {
+		std::cout << res << "\n";
+	}
+	std::cerr << stats;
+	return 0;
+}
+
+/// Checks that the graders and the caches of the searches agree.
+///
+/// Grades the sudokus of the file with \ref grade_rec_depth() and with
+/// \ref solve_count_rec_depth() with and without the transposition table,
+/// under the full propagation and under profiles with fewer techniques below
+/// a depth. Counts the solutions of the sudokus with a known number of
+/// solutions and checks that \ref count_solutions() uses the band
+/// decomposition for them. Returns 1 if any result differs.
+///
+/// Usage: Sudoku --check file [--threads n]
+int run_check(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: Sudoku --check file [--threads n]\n";
+		return 1;
+	}
+	unsigned int n_threads = default_num_threads();
+	if (argc > 4 && std::string(argv[3]) == "--threads") {
+		n_threads = (unsigned int)std::max(1, std::atoi(argv[4]));
+	}
+	std::vector<raw_sudoku_t> suds;
+	std::size_t n_invalid = 0;
+	const bool read = parse_sudoku_file(argv[2], [&](const ParsedSudokuLine & line) {
+		suds.push_back(line.sud);
+	}, n_invalid);
+	if (!read) {
+		std::cerr << "Could not read " << argv[2] << "\n";
+		return 1;
+	}
+
+	WorkStealingPool pool(n_threads);
+	bool ok = true;
+	const std::size_t n_full = count_grade_cache_mismatches(pool, suds.data(), suds.size());
+	std::cout << "Grading, full propagation: " << n_full << " mismatches\n";
+	ok = ok && n_full == 0;
+	for (int k = 0; k <= 3; ++k) {
+		const PropagationProfile profile = PropagationProfile::singles_below(k);
+		const std::size_t n_diff = count_grade_cache_mismatches(pool, suds.data(), suds.size(), &profile);
+		std::cout << "Grading, singles below depth " << k << ": " << n_diff << " mismatches\n";
+		ok = ok && n_diff == 0;
+	}
+
+	const std::array<std::pair<raw_sudoku_t, std::int64_t>, 3> known = { {
+		{ only_53_solutions_sudoku_3x3, 53 },
+		{ many_11199_solutions_sudoku_3x3, 11199 },
+		{ many_177859_solutions_sudoku_3x3, 177859 },
+	} };
+	for (const auto& k : known) {
+		sudoku_data_t s_data = init_sudoku_with_raw(k.first);
+		auto_fill(s_data, true);
+		CountMethod method;
+		const std::int64_t n_sols = count_solutions<3, 3>(s_data, nullptr, &method);
+		const bool k_ok = n_sols == k.second && method == CountBandDecomposition;
+		std::cout << "Counting " << k.second << " solutions: " << n_sols << " by "
+			<< (method == CountBandDecomposition ? "band decomposition" : "brute force") << (k_ok ? "\n" : ", mismatch\n");
+		ok = ok && k_ok;
+	}
+	return ok ? 0 : 1;
+}
+
 /// The main function.
 ///
 /// It executes everything that is needed.
 int main(int argc, char* argv[]){
 
+	if (argc > 1 && std::string(argv[1]) == "--batch") {
+		return run_batch(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench") {
+		return run_bench(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--grade") {
+		return run_grade(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--check") {
+		return run_check(argc, argv);
+	}
+
 
 	const raw_sudoku_t input_sudoku_3x3 = {
 		6, 0, 0, 0, 0, 8, 9, 4, 0,
@@ -61,39 +265,6 @@ int main(int argc, char* argv[]){
 	0, 9, 0, 0, 0, 0, 4, 0, 0
 	};	
 
-	const raw_sudoku_t only_53_solutions_sudoku_3x3 = {
-		5,0,0,0,0,0,0,0,7,
-		0,0,0,4,6,2,0,0,1,
-		0,0,0,1,0,0,3,4,0,
-		0,0,0,0,4,0,1,0,0,
-		0,0,0,2,0,6,0,0,0,
-		0,0,8,0,3,0,0,0,0,
-		0,5,1,0,0,4,0,0,0,
-		2,0,0,0,8,7,0,0,0,
-		9,0,0,0,0,0,0,0,8
-	};
-	const raw_sudoku_t many_11199_solutions_sudoku_3x3 = {
-		5,0,0,0,0,0,0,0,7,
-		0,0,0,4,0,2,0,0,1,
-		0,0,0,1,0,0,0,4,0,
-		0,0,0,0,4,0,1,0,0,
-		0,0,0,0,0,6,0,0,0,
-		0,0,8,0,3,0,0,0,0,
-		0,5,1,0,0,4,0,0,0,
-		2,0,0,5,8,7,0,0,0,
-		9,0,0,0,0,0,0,0,8
-	};
-	const raw_sudoku_t many_177859_solutions_sudoku_3x3 = {
-		5,0,0,0,0,0,0,0,7,
-		0,0,0,4,0,2,0,0,1,
-		0,0,0,1,0,0,0,4,0,
-		0,0,0,0,4,0,1,0,0,
-		0,0,0,0,0,6,0,0,0,
-		0,0,8,0,3,0,0,0,0,
-		0,5,0,0,0,4,0,0,0,
-		2,0,0,0,8,7,0,0,0,
-		9,0,0,0,0,0,0,0,8
-	};
 	const raw_sudoku_t too_maaaaany_sol_sudoku_3x3 = {
 		0,0,0,0,0,0,0,0,0,
 		0,0,0,0,0,0,0,0,0,
@@ -131,10 +302,10 @@ int main(int argc, char* argv[]){
 	auto_fill(sudoku, true);
 	raw_sudoku_t raw_sud = get_raw_sudoku(sudoku);
 
-	std::cout << solve_brute_force_all<3, 3>(sudoku) << " Solutions\n";
+	std::cout << count_solutions<3, 3>(sudoku) << " Solutions\n";
 	sudoku = init_sudoku_with_raw(input_sudoku);
 	auto_fill(sudoku, true);
-	std::cout << solve_count_rec_depth<3, 3>(sudoku) << " Min. Recursion Depth\n";
+	std::cout << grade_rec_depth<3, 3>(sudoku) << " Min. Recursion Depth\n";
 
 	raw_sud = get_raw_sudoku(sudoku);
 	std::cout << raw_sud << "\n";
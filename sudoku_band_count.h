@@ -0,0 +1,351 @@
+#pragma once
+
+#include "Lib.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Band Decomposition Counting
+//
+// Counts the solutions of weakly constrained sudokus exactly without
+// visiting every solution. The grid is split into three bands of
+// \ref square_height rows. The completions of the first band are enumerated
+// and grouped into classes by the numbers they leave in each col, the
+// signature. All completions of a class have the same number of completions
+// of the other two bands, so that number is computed once per class. For the
+// second band the same is done per signature of the first two bands: the
+// third band must use exactly the remaining numbers of each col, and its
+// count is cached per such signature. The band with the most clues is
+// enumerated first, using the stacks instead of the bands if that is better.
+// Each band avoids the numbers of the clues of the other bands in its cols.
+
+/// Numbers of one band per col, a \ref cand_mask_t per col.
+typedef std::array<cand_mask_t, side_len> band_signature_t;
+
+/// Table of the classes: Index of every set of \ref square_height numbers.
+///
+/// A signature is packed into 64 bits by replacing each col by the index
+/// of its set of numbers.
+struct BandClassTable {
+	std::array<std::int16_t, 1 << side_len> index; ///< Index of the set, -1 if it has not square_height numbers.
+	int n_sets = 0; ///< Number of sets.
+	int bits = 0; ///< Bits per col in the packed signature.
+
+	BandClassTable() {
+		index.fill(-1);
+		for (int m = 0; m < (1 << side_len); ++m) {
+			if (count_cands((cand_mask_t)m) == square_height) index[m] = (std::int16_t)n_sets++;
+		}
+		while ((1 << bits) < n_sets) {
+			++bits;
+		}
+		assert(bits * side_len <= 64);
+	}
+
+	/// Packs a complete signature.
+	std::uint64_t pack(const band_signature_t & sig) const {
+		std::uint64_t key = 0;
+		for (const cand_mask_t m : sig) {
+			key = (key << bits) | (std::uint64_t)index[m];
+		}
+		return key;
+	}
+};
+
+/// Returns the class table, computed once.
+inline const BandClassTable & get_band_class_table() {
+	static const BandClassTable table;
+	return table;
+}
+
+/// Exact counter using the band decomposition.
+class BandCounter {
+
+public:
+	/// Prepares counting the solutions of 's', the nodes are counted in 'budget' if given.
+	explicit BandCounter(const raw_sudoku_t & s, SearchBudget * budget = nullptr) : budget(budget) {
+		static_assert(square_height == square_width, "The stacks are used by transposing.");
+
+		// Orientation and order of the bands: Most clues first
+		for (int transposed = 0; transposed < 2; ++transposed) {
+			raw_sudoku_t g;
+			std::array<int, square_width> n_clues = {};
+			for (sudoku_size_t r = 0; r < side_len; ++r) {
+				for (sudoku_size_t c = 0; c < side_len; ++c) {
+					g[r * side_len + c] = transposed ? s[c * side_len + r] : s[r * side_len + c];
+					n_clues[r / square_height] += g[r * side_len + c] > 0;
+				}
+			}
+			std::array<int, square_width> order;
+			for (int b = 0; b < square_width; ++b) {
+				order[b] = b;
+			}
+			std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return n_clues[a] > n_clues[b]; });
+			if (n_clues[order[0]] > n_first_clues) {
+				n_first_clues = n_clues[order[0]];
+				grid = g;
+				band_order = order;
+			}
+		}
+
+		// Numbers of the clues of the other bands per col
+		for (int b = 0; b < square_width; ++b) {
+			outside_clues[b].fill(0);
+			for (sudoku_size_t r = 0; r < side_len; ++r) {
+				for (sudoku_size_t c = 0; c < side_len; ++c) {
+					const sudoku_value_t clue = grid[r * side_len + c];
+					if (clue > 0 && (int)(r / square_height) != b) outside_clues[b][c] |= (cand_mask_t)(1 << (clue - 1));
+				}
+			}
+		}
+	}
+
+	/// Returns the number of solutions, -1 if the budget was exceeded or the
+	/// count does not fit into std::int64_t, see \ref overflowed().
+	std::int64_t count() {
+		static_assert(side_len / square_height == 3, "The band decomposition needs three bands.");
+		const BandClassTable & table = get_band_class_table();
+
+		// Classes of the first band
+		std::unordered_map<std::uint64_t, std::pair<band_signature_t, std::uint64_t> > classes;
+		band_signature_t none;
+		none.fill(0);
+		enumerate_band(band_order[0], none, nullptr, [&](const band_signature_t & sig1) {
+			auto& cl = classes[table.pack(sig1)];
+			cl.first = sig1;
+			++cl.second;
+		});
+		if (stopped) {
+			return -1;
+		}
+
+		// Completions of the other bands per class
+		std::uint64_t total = 0;
+		for (const auto& cl : classes) {
+			const band_signature_t & sig1 = cl.second.first;
+			std::uint64_t n_lower = 0;
+			enumerate_band(band_order[1], sig1, nullptr, [&](const band_signature_t & sig2) {
+				band_signature_t sig3;
+				for (sudoku_size_t c = 0; c < side_len; ++c) {
+					sig3[c] = all_cands & (cand_mask_t)~(sig1[c] | sig2[c]);
+				}
+				add_checked(n_lower, count_last_band(sig3));
+			});
+			if (stopped) {
+				return -1;
+			}
+			if (n_lower > 0 && cl.second.second > max_count / n_lower) {
+				overflow = true;
+			}
+			else {
+				add_checked(total, cl.second.second * n_lower);
+			}
+			if (overflow) {
+				return -1;
+			}
+		}
+		return (std::int64_t)total;
+	}
+
+	/// Number of clues in the band that is enumerated first, the densest band or stack.
+	int first_band_clues() const {
+		return n_first_clues;
+	}
+
+	/// True if \ref count() failed because the count exceeds std::int64_t.
+	bool overflowed() const {
+		return overflow;
+	}
+
+	/// Number of classes of the last band that were counted.
+	std::size_t n_cached() const {
+		return last_band_cache.size();
+	}
+
+private:
+	/// Largest count that can be returned.
+	static constexpr std::uint64_t max_count = (std::uint64_t)std::numeric_limits<std::int64_t>::max();
+
+	/// Adds 'n' to 'sum', sets \ref overflow if the result exceeds \ref max_count.
+	void add_checked(std::uint64_t & sum, const std::uint64_t n) {
+		if (n > max_count - std::min(sum, max_count)) {
+			overflow = true;
+			sum = max_count;
+		}
+		else {
+			sum += n;
+		}
+	}
+
+	/// State of the enumeration of one band.
+	struct BandState {
+		std::array<cand_mask_t, square_height> row_used;
+		std::array<cand_mask_t, side_len / square_width> box_used;
+		band_signature_t col_used;
+	};
+
+	/// Calls 'f(signature)' for every completion of 'band' that avoids the numbers 'excl' in each col.
+	///
+	/// If 'exact' is given, each col has to use exactly these numbers. The
+	/// numbers of the clues of the other bands are avoided as well.
+	template<typename Func>
+	void enumerate_band(const int band, const band_signature_t & excl_given, const band_signature_t * exact, Func && f) {
+		band_signature_t excl;
+		for (sudoku_size_t c = 0; c < side_len; ++c) {
+			excl[c] = excl_given[c] | outside_clues[band][c];
+		}
+		BandState st;
+		st.row_used.fill(0);
+		st.box_used.fill(0);
+		st.col_used.fill(0);
+
+		// Place the clues first, so the free cells avoid their numbers
+		for (sudoku_size_t r = 0; r < square_height; ++r) {
+			for (sudoku_size_t c = 0; c < side_len; ++c) {
+				const sudoku_value_t clue = grid[(band * square_height + r) * side_len + c];
+				if (clue <= 0) {
+					continue;
+				}
+				const cand_mask_t bit = (cand_mask_t)(1 << (clue - 1));
+				const sudoku_size_t box = c / square_width;
+				if (((st.row_used[r] | st.col_used[c] | st.box_used[box] | excl[c]) & bit)
+					|| (exact && !((*exact)[c] & bit))) {
+					return;
+				}
+				st.row_used[r] |= bit;
+				st.col_used[c] |= bit;
+				st.box_used[box] |= bit;
+			}
+		}
+		enumerate_rec(band, 0, st, excl, exact, f);
+	}
+
+	template<typename Func>
+	void enumerate_rec(const int band, const sudoku_size_t k, BandState & st, const band_signature_t & excl,
+		const band_signature_t * exact, Func & f) {
+
+		if (stopped || (budget && budget->enter_node())) {
+			stopped = true;
+			return;
+		}
+		if (k == square_height * side_len) {
+			f(st.col_used);
+			return;
+		}
+
+		const sudoku_size_t r = k / side_len, c = k % side_len, box = c / square_width;
+		if (grid[(band * square_height + r) * side_len + c] > 0) {
+			enumerate_rec(band, k + 1, st, excl, exact, f);
+			return;
+		}
+		cand_mask_t cands = all_cands & (cand_mask_t)~(st.row_used[r] | st.col_used[c] | st.box_used[box] | excl[c]);
+		if (exact) {
+			cands &= (*exact)[c];
+		}
+		while (cands) {
+			const cand_mask_t bit = cands & (cand_mask_t)(-cands);
+			cands &= (cand_mask_t)~bit;
+			st.row_used[r] |= bit;
+			st.col_used[c] |= bit;
+			st.box_used[box] |= bit;
+			enumerate_rec(band, k + 1, st, excl, exact, f);
+			st.row_used[r] &= (cand_mask_t)~bit;
+			st.col_used[c] &= (cand_mask_t)~bit;
+			st.box_used[box] &= (cand_mask_t)~bit;
+		}
+	}
+
+	/// Number of completions of the last band with exactly the numbers 'sig' per col, cached.
+	std::uint64_t count_last_band(const band_signature_t & sig) {
+		const std::uint64_t key = get_band_class_table().pack(sig);
+		const auto it = last_band_cache.find(key);
+		if (it != last_band_cache.end()) {
+			return it->second;
+		}
+		std::uint64_t n = 0;
+		band_signature_t none;
+		none.fill(0);
+		enumerate_band(band_order[2], none, &sig, [&](const band_signature_t &) { ++n; });
+		if (!stopped) {
+			last_band_cache[key] = n;
+		}
+		return n;
+	}
+
+	raw_sudoku_t grid; ///< The sudoku, transposed if the stacks are used.
+	std::array<int, square_width> band_order; ///< The bands in the order they are counted.
+	int n_first_clues = -1; ///< Number of clues of the first band.
+	std::array<band_signature_t, square_width> outside_clues; ///< Numbers of the clues outside each band per col.
+	std::unordered_map<std::uint64_t, std::uint64_t> last_band_cache; ///< Counts of the last band per signature.
+	SearchBudget * budget;
+	bool stopped = false;
+	bool overflow = false;
+};
+
+/// Minimum number of clues in the densest band or stack for which
+/// \ref count_solutions() uses the band decomposition right away.
+constexpr int band_count_min_clues = 11;
+
+/// Number of nodes \ref count_solutions() searches before it uses the band decomposition.
+constexpr std::uint64_t band_count_probe_nodes = 4096;
+
+/// How \ref count_solutions() counted the solutions.
+enum CountMethod {
+	CountBruteForce, ///< Every solution was visited by solve_brute_force_all().
+	CountBandDecomposition, ///< The solutions were counted by a \ref BandCounter.
+};
+
+// Count all solutions like solve_brute_force_all()
+// The cost of the band decomposition depends on the completions of the
+// first band, so it is used right away if the densest band or stack has
+// at least band_count_min_clues clues. Otherwise the search is first
+// limited to band_count_probe_nodes nodes, which suffices for sudokus with
+// few solutions, and the band decomposition only counts if it does not.
+// The method used is written to 'method' if given.
+// Returns -1 if the search was stopped, the partial count is in the budget,
+// or if the count does not fit into std::int64_t.
+// Otherwise 's_data' holds a solution if there is one.
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo>
+std::int64_t count_solutions(sudoku_data_t & s_data, SearchBudget * budget = nullptr, CountMethod * method = nullptr) {
+	const raw_sudoku_t s = get_raw_sudoku(s_data);
+	BandCounter counter(s, budget);
+	if (method) *method = CountBruteForce;
+	if (counter.first_band_clues() < band_count_min_clues) {
+
+		// Short search within the limits of the budget
+		SearchBudget probe = budget ? *budget : SearchBudget();
+		const std::uint64_t probe_end = probe.n_nodes + band_count_probe_nodes;
+		if (probe.max_nodes == 0 || probe.max_nodes > probe_end) {
+			probe.max_nodes = probe_end;
+		}
+		sudoku_data_t s_data_probe = s_data;
+		const int n_probe = solve_brute_force_all<square_height, square_width, printDebugInfo>(s_data_probe, &probe);
+		if (budget) {
+			budget->n_nodes = probe.n_nodes;
+			budget->n_sols = probe.n_sols;
+			budget->cancelled = probe.cancelled;
+		}
+		if (n_probe >= 0) {
+			s_data = s_data_probe;
+			return n_probe;
+		}
+		if (probe.cancelled) {
+			return -1;
+		}
+	}
+
+	if (method) *method = CountBandDecomposition;
+	const std::int64_t n_sols = counter.count();
+	if (n_sols > 0) {
+		if (budget) budget->n_sols = (std::uint64_t)n_sols;
+		sudoku_data_t s_data_copy = s_data;
+		const int n_found = enumerate_solutions<square_height, square_width, printDebugInfo>(s_data_copy, [&](const raw_sudoku_t & sol) {
+			for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+				s_data[c * n_stored_per_cell] = sol[c];
+			}
+			return false;
+		}, 1, budget);
+		if (n_found < 0) {
+			return -1;
+		}
+	}
+	return n_sols;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <atomic>
+#include <functional>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread Pool
+
+/// Persistent pool of worker threads with chunked work stealing.
+///
+/// \ref parallel_for() splits the index range into one contiguous part per
+/// worker. Each worker takes chunks from the front of its own part and,
+/// once that is exhausted, steals chunks from the parts of the others.
+/// The calling thread takes part as worker 0.
+class WorkStealingPool {
+
+public:
+	/// Function processing the indices [begin, end) on worker 'worker_id'.
+	typedef std::function<void(std::size_t begin, std::size_t end, unsigned int worker_id)> range_func_t;
+
+	/// Starts 'n_threads' - 1 background workers.
+	explicit WorkStealingPool(const unsigned int n_threads = default_num_threads())
+		: n_workers(std::max(1u, n_threads)), parts(n_workers) {
+		for (unsigned int w = 1; w < n_workers; ++w) {
+			threads.emplace_back(&WorkStealingPool::worker_loop, this, w);
+		}
+	}
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+	~WorkStealingPool() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		start_cv.notify_all();
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+
+	/// Number of workers including the calling thread.
+	unsigned int num_workers() const {
+		return n_workers;
+	}
+
+	/// Calls 'f' on chunks of at most 'chunk_size' indices until [0, n) is covered.
+	///
+	/// Blocks until all chunks are processed. Not reentrant.
+	void parallel_for(const std::size_t n, const std::size_t chunk_size, const range_func_t & f) {
+		if (n == 0) {
+			return;
+		}
+
+		// Split the range
+		for (unsigned int w = 0; w < n_workers; ++w) {
+			parts[w].next.store(n * w / n_workers, std::memory_order_relaxed);
+			parts[w].end = n * (w + 1) / n_workers;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			job = &f;
+			chunk = std::max<std::size_t>(1, chunk_size);
+			n_busy = n_workers - 1;
+			++generation;
+		}
+		start_cv.notify_all();
+
+		// Work on the calling thread, then wait for the others
+		run(0);
+		std::unique_lock<std::mutex> lock(mtx);
+		done_cv.wait(lock, [&]() { return n_busy == 0; });
+		job = nullptr;
+	}
+
+private:
+	/// Range of indices owned by one worker, padded to avoid false sharing.
+	struct alignas(64) Part {
+		std::atomic<std::size_t> next{ 0 };
+		std::size_t end = 0;
+	};
+
+	/// Processes the own part, then steals from the others.
+	void run(const unsigned int worker_id) {
+		for (unsigned int k = 0; k < n_workers; ++k) {
+			Part & p = parts[(worker_id + k) % n_workers];
+			while (true) {
+				const std::size_t beg = p.next.fetch_add(chunk, std::memory_order_relaxed);
+				if (beg >= p.end) {
+					break;
+				}
+				(*job)(beg, std::min(beg + chunk, p.end), worker_id);
+			}
+		}
+	}
+
+	/// Background worker: waits for a new job and runs it.
+	void worker_loop(const unsigned int worker_id) {
+		std::uint64_t seen_generation = 0;
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			start_cv.wait(lock, [&]() { return stop || generation != seen_generation; });
+			if (stop) {
+				return;
+			}
+			seen_generation = generation;
+			lock.unlock();
+			run(worker_id);
+			lock.lock();
+			if (--n_busy == 0) {
+				done_cv.notify_one();
+			}
+		}
+	}
+
+	const unsigned int n_workers;
+	std::vector<Part> parts;
+	std::vector<std::thread> threads;
+
+	std::mutex mtx;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	const range_func_t * job = nullptr;
+	std::size_t chunk = 1;
+	unsigned int n_busy = 0;
+	std::uint64_t generation = 0;
+	bool stop = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Batch Solving
+
+/// What to compute for each sudoku of a batch.
+enum BatchMode {
+	BatchSolve, ///< Find a solution and check uniqueness.
+	BatchCheckUnique, ///< Only check uniqueness.
+	BatchCountUpTo, ///< Count the solutions up to a maximum.
+	BatchGrade, ///< Find the level, see \ref grade_rec_depth().
+};
+
+/// Result for one sudoku of a batch.
+struct BatchResult {
+	SolveResultFinal status; ///< Invalid, unique, multiple, timeout or cancelled.
+	int n_sols; ///< Number of solutions found (\ref BatchCountUpTo only).
+	rec_depth_t lvl; ///< Level (\ref BatchGrade only).
+	std::uint64_t n_nodes; ///< Number of search nodes.
+	raw_sudoku_t solution; ///< A solution (\ref BatchSolve and \ref BatchCountUpTo only).
+};
+
+/// Solves a single sudoku of a batch within the per sudoku 'limits'.
+///
+/// The searches propagate with 'profile' if given, see \ref ProfileScope.
+inline void batch_solve_one(const raw_sudoku_t & s, const BatchMode mode, const int max_sols, BatchResult & res,
+	const SearchLimits & limits = SearchLimits(), const CancelToken * cancel = nullptr,
+	const PropagationProfile * profile = nullptr) {
+	ProfileScope profile_scope(profile);
+	res.n_sols = 0;
+	res.lvl = -3;
+	res.n_nodes = 0;
+	if (cancel != nullptr && cancel->is_cancelled()) {
+		res.status = CancelledSolution;
+		res.solution = s;
+		return;
+	}
+	sudoku_data_t s_data = init_sudoku_with_raw(s);
+	auto_fill(s_data, true);
+	SearchBudget budget(limits, cancel);
+	switch (mode) {
+	case BatchSolve:
+	case BatchCheckUnique:
+		res.status = solve_brute_force_multiple<square_height, square_width>(s_data, &budget);
+		break;
+	case BatchCountUpTo:
+		res.n_sols = solve_brute_force_count<square_height, square_width>(s_data, max_sols, &budget);
+		if (res.n_sols < 0) {
+			res.n_sols = (int)budget.n_sols;
+			res.status = budget.stop_result();
+		}
+		else {
+			res.status = res.n_sols == 0 ? InvalidSolution : (res.n_sols == 1 ? UniqueSolution : MultipleSolution);
+		}
+		break;
+	case BatchGrade:
+		res.lvl = grade_rec_depth<square_height, square_width>(s_data, &budget);
+		res.status = res.lvl >= 0 ? UniqueSolution : (res.lvl == -1 ? MultipleSolution
+			: (res.lvl <= -4 ? budget.stop_result() : InvalidSolution));
+		break;
+	}
+	res.n_nodes = budget.n_nodes;
+	if (mode == BatchSolve || mode == BatchCountUpTo) {
+		res.solution = get_raw_sudoku(s_data);
+	}
+}
+
+/// Processes the sudokus 'suds[0, n)' on the pool and writes 'results[0, n)'.
+///
+/// 'max_sols' is only used for \ref BatchCountUpTo. The work is scheduled in
+/// chunks of 'chunk_size' sudokus, nothing is allocated per sudoku. Sudokus
+/// exceeding the 'limits' get the status \ref TimeoutSolution. Once 'cancel'
+/// is cancelled, the running searches unwind and all remaining sudokus get
+/// the status \ref CancelledSolution. The searches propagate with 'profile'
+/// if given, e.g. one picked by \ref tune_profile().
+inline void solve_batch(WorkStealingPool & pool, const raw_sudoku_t * suds, const std::size_t n,
+	BatchResult * results, const BatchMode mode, const int max_sols = 2, const std::size_t chunk_size = 16,
+	const SearchLimits & limits = SearchLimits(), const CancelToken * cancel = nullptr,
+	const PropagationProfile * profile = nullptr) {
+	pool.parallel_for(n, chunk_size, [&](const std::size_t beg, const std::size_t end, const unsigned int) {
+		for (std::size_t i = beg; i < end; ++i) {
+			batch_solve_one(suds[i], mode, max_sols, results[i], limits, cancel, profile);
+		}
+	});
+}
+
+/// Processes all sudokus of 'suds', 'results' must have the same size.
+inline void solve_batch(WorkStealingPool & pool, const std::vector<raw_sudoku_t> & suds,
+	std::vector<BatchResult> & results, const BatchMode mode, const int max_sols = 2,
+	const SearchLimits & limits = SearchLimits(), const CancelToken * cancel = nullptr,
+	const PropagationProfile * profile = nullptr) {
+	assert(results.size() == suds.size());
+	solve_batch(pool, suds.data(), suds.size(), results.data(), mode, max_sols, 16, limits, cancel, profile);
+}
+
+/// Grades 'suds[0, n)' with \ref grade_rec_depth() and with \ref solve_count_rec_depth(),
+/// once with and once without a \ref TranspositionTable shared by all workers.
+///
+/// Returns the number of sudokus with another level from any of them, which
+/// must be 0 for any 'profile'.
+inline std::size_t count_grade_cache_mismatches(WorkStealingPool & pool, const raw_sudoku_t * suds, const std::size_t n,
+	const PropagationProfile * profile = nullptr) {
+	std::vector<BatchResult> graded(n);
+	std::vector<rec_depth_t> cached(n);
+	std::vector<rec_depth_t> uncached(n);
+	solve_batch(pool, suds, n, graded.data(), BatchGrade, 2, 16, SearchLimits(), nullptr, profile);
+	TranspositionTable tt(1 << 16);
+	pool.parallel_for(n, 16, [&](const std::size_t beg, const std::size_t end, const unsigned int) {
+		ProfileScope profile_scope(profile);
+		for (std::size_t i = beg; i < end; ++i) {
+			sudoku_data_t s_data = init_sudoku_with_raw(suds[i]);
+			auto_fill(s_data, true);
+			cached[i] = solve_count_rec_depth<square_height, square_width>(s_data, 0, nullptr, &tt);
+			s_data = init_sudoku_with_raw(suds[i]);
+			auto_fill(s_data, true);
+			uncached[i] = solve_count_rec_depth<square_height, square_width>(s_data);
+		}
+	});
+	std::size_t n_mismatches = 0;
+	for (std::size_t i = 0; i < n; ++i) {
+		n_mismatches += graded[i].lvl != uncached[i] || cached[i] != uncached[i];
+	}
+	return n_mismatches;
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <functional>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmarks with Hardware Counters
+//
+// Runs solver engines on every sudoku of a collection and reads the
+// hardware performance counters of the calling thread around each call
+// (Linux perf_event_open). The results are aggregated per engine and per
+// level, see \ref get_sud_char_level(). Where the counters are not
+// available (other systems, missing permissions, virtual machines), only
+// the wall time is reported.
+
+/// The hardware counters that are read.
+enum PerfCounter {
+	PerfCycles, ///< CPU cycles.
+	PerfInstructions, ///< Retired instructions.
+	PerfL1dMisses, ///< L1 data cache read misses.
+	PerfLlcMisses, ///< Last level cache misses.
+	PerfBranchMisses, ///< Mispredicted branches.
+};
+
+/// Number of \ref PerfCounter.
+constexpr int n_perf_counters = 5;
+
+/// String array mapping each \ref PerfCounter to its name.
+const std::string perf_counter_names[n_perf_counters] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+
+/// Counter values of one measurement.
+struct PerfSample {
+	std::array<std::uint64_t, n_perf_counters> values = {}; ///< Counter values, 0 if not available.
+	double seconds = 0.0; ///< Wall time.
+};
+
+/// Group of hardware counters of the calling thread.
+class PerfCounterGroup {
+
+public:
+	/// Opens all counters that are available.
+	PerfCounterGroup() {
+		fds.fill(-1);
+#ifdef __linux__
+		const std::uint32_t types[n_perf_counters] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+			PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+		const std::uint64_t configs[n_perf_counters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		for (int c = 0; c < n_perf_counters; ++c) {
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = types[c];
+			attr.config = configs[c];
+			attr.disabled = leader < 0 ? 1 : 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+			const int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+			if (fd < 0) {
+				continue;
+			}
+			if (leader < 0) {
+				leader = fd;
+			}
+			fds[c] = fd;
+			order[n_open++] = c;
+		}
+#endif
+	}
+
+	PerfCounterGroup(const PerfCounterGroup &) = delete;
+	PerfCounterGroup & operator=(const PerfCounterGroup &) = delete;
+
+	~PerfCounterGroup() {
+#ifdef __linux__
+		for (const int fd : fds) {
+			if (fd >= 0) close(fd);
+		}
+#endif
+	}
+
+	/// True if at least one counter could be opened.
+	bool available() const {
+		return n_open > 0;
+	}
+
+	/// True if the counter 'c' could be opened.
+	bool available(const PerfCounter c) const {
+		return fds[c] >= 0;
+	}
+
+	/// Resets and starts the counters.
+	void start() {
+#ifdef __linux__
+		if (leader >= 0) {
+			ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+#endif
+		t_start = std::chrono::steady_clock::now();
+	}
+
+	/// Stops the counters and returns their values.
+	PerfSample stop() {
+		PerfSample res;
+		res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+#ifdef __linux__
+		if (leader >= 0) {
+			ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			std::uint64_t buf[1 + n_perf_counters];
+			if (read(leader, buf, sizeof(buf)) >= (ssize_t)sizeof(std::uint64_t)) {
+				for (std::uint64_t k = 0; k < buf[0] && k < (std::uint64_t)n_open; ++k) {
+					res.values[order[k]] = buf[1 + k];
+				}
+			}
+		}
+#endif
+		return res;
+	}
+
+private:
+	std::array<int, n_perf_counters> fds;
+	std::array<int, n_perf_counters> order = {};
+	int n_open = 0;
+	int leader = -1;
+	std::chrono::steady_clock::time_point t_start;
+};
+
+/// A solver engine, solves the sudoku passed as raw sudoku.
+struct BenchEngine {
+	std::string name; ///< Name in the report.
+	std::function<void(const raw_sudoku_t &)> solve; ///< Solves one sudoku.
+};
+
+/// The engines of Lib.h.
+inline std::vector<BenchEngine> default_bench_engines() {
+	std::vector<BenchEngine> engines;
+	engines.push_back({ "brute_force_multiple", [](const raw_sudoku_t & s) {
+		sudoku_data_t s_data = init_sudoku_with_raw(s);
+		auto_fill(s_data, true);
+		solve_brute_force_multiple<square_height, square_width>(s_data);
+	} });
+	engines.push_back({ "brute_force_count", [](const raw_sudoku_t & s) {
+		sudoku_data_t s_data = init_sudoku_with_raw(s);
+		auto_fill(s_data, true);
+		solve_brute_force_count<square_height, square_width>(s_data, 2);
+	} });
+	engines.push_back({ "count_rec_depth", [](const raw_sudoku_t & s) {
+		sudoku_data_t s_data = init_sudoku_with_raw(s);
+		auto_fill(s_data, true);
+		solve_count_rec_depth<square_height, square_width>(s_data);
+	} });
+	engines.push_back({ "grade_rec_depth", [](const raw_sudoku_t & s) {
+		sudoku_data_t s_data = init_sudoku_with_raw(s);
+		auto_fill(s_data, true);
+		grade_rec_depth<square_height, square_width>(s_data);
+	} });
+	return engines;
+}
+
+/// Aggregated measurements of one engine on one level.
+struct BenchRow {
+	std::string engine; ///< Name of the engine.
+	rec_depth_t lvl = 0; ///< Level of the sudokus.
+	std::uint64_t n_suds = 0; ///< Number of solved sudokus.
+	PerfSample total; ///< Sum over all sudokus.
+};
+
+/// Report of a benchmark run.
+struct BenchReport {
+	std::vector<BenchRow> rows; ///< One row per engine and level.
+	std::array<bool, n_perf_counters> counter_available = {}; ///< Which counters could be read.
+};
+
+/// Prints the report as CSV, values per sudoku.
+inline std::ostream& operator<<(std::ostream & os, const BenchReport & rep) {
+	os << "engine,level,n,us";
+	for (int c = 0; c < n_perf_counters; ++c) {
+		if (rep.counter_available[c]) os << "," << perf_counter_names[c];
+	}
+	if (rep.counter_available[PerfCycles] && rep.counter_available[PerfInstructions]) os << ",ipc";
+	os << "\n";
+	for (const auto& r : rep.rows) {
+		const double n = (double)std::max<std::uint64_t>(1, r.n_suds);
+		os << r.engine << "," << r.lvl << "," << r.n_suds << "," << 1e6 * r.total.seconds / n;
+		for (int c = 0; c < n_perf_counters; ++c) {
+			if (rep.counter_available[c]) os << "," << r.total.values[c] / n;
+		}
+		if (rep.counter_available[PerfCycles] && rep.counter_available[PerfInstructions]) {
+			os << "," << (r.total.values[PerfCycles] > 0 ? (double)r.total.values[PerfInstructions] / r.total.values[PerfCycles] : 0.0);
+		}
+		os << "\n";
+	}
+	return os;
+}
+
+/// Runs all engines on all sudokus of the collection, 'n_repeats' times each.
+///
+/// Runs on the calling thread, the counters only count this thread.
+inline BenchReport run_benchmark(const sud_coll_t & sud_map, const std::vector<BenchEngine> & engines = default_bench_engines(),
+	const int n_repeats = 1) {
+
+	PerfCounterGroup counters;
+	BenchReport rep;
+	for (int c = 0; c < n_perf_counters; ++c) {
+		rep.counter_available[c] = counters.available((PerfCounter)c);
+	}
+	if (!counters.available()) {
+		std::cerr << "Hardware counters not available, reporting wall time only.\n";
+	}
+
+	for (const auto& engine : engines) {
+		std::map<rec_depth_t, BenchRow> per_lvl;
+		for (int rep_ind = 0; rep_ind < n_repeats; ++rep_ind) {
+			for (std::size_t i = 0; i < sud_map.size(); ++i) {
+				const rec_depth_t lvl = get_sud_char_level(sud_map.get_desc(i));
+				const raw_sudoku_t s = sud_map.get(i).first;
+				counters.start();
+				engine.solve(s);
+				const PerfSample sample = counters.stop();
+
+				BenchRow & row = per_lvl[lvl];
+				++row.n_suds;
+				row.total.seconds += sample.seconds;
+				for (int c = 0; c < n_perf_counters; ++c) {
+					row.total.values[c] += sample.values[c];
+				}
+			}
+		}
+		for (auto& lvl_row : per_lvl) {
+			lvl_row.second.engine = engine.name;
+			lvl_row.second.lvl = lvl_row.first;
+			rep.rows.push_back(lvl_row.second);
+		}
+	}
+	return rep;
+}
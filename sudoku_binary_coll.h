@@ -0,0 +1,318 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary Collection Format
+//
+// Layout: A \ref BinaryCollHeader followed by fixed size records
+// (\ref BinarySudRecord) that are sorted by level. All integers are stored
+// in the byte order of the machine that wrote the file (little endian on x86).
+
+/// Version of the binary format.
+constexpr std::uint32_t binary_coll_version = 1;
+
+/// Maximum number of levels in the level index.
+constexpr std::uint32_t binary_coll_max_lvl = 16;
+
+/// Header of a binary collection file.
+struct BinaryCollHeader {
+	char magic[8]; ///< "SUDCOLL" with trailing zero.
+	std::uint32_t version; ///< \ref binary_coll_version.
+	std::uint32_t record_size; ///< sizeof(\ref BinarySudRecord).
+	std::uint64_t n_records; ///< Number of records.
+	std::uint64_t lvl_begin[binary_coll_max_lvl]; ///< Index of first record of each level.
+	std::uint64_t lvl_count[binary_coll_max_lvl]; ///< Number of records of each level.
+};
+
+/// A sudoku, its solution and its description packed into a fixed size record.
+struct BinarySudRecord {
+	packed_sudoku_t sud; ///< The sudoku, 4 bits per cell.
+	packed_sudoku_t sol; ///< The solution, 4 bits per cell.
+	std::uint8_t lvl; ///< Level of the sudoku.
+	std::uint8_t n_filled; ///< Number of filled-in digits.
+	std::uint8_t freq[side_len]; ///< Decreasing frequency count of the numbers.
+	std::uint8_t padding[4 - (2 * packed_sudoku_size + 2 + side_len) % 4]; ///< Zero.
+};
+
+static_assert(sizeof(BinarySudRecord) % 4 == 0 && alignof(BinarySudRecord) == 1, "Unexpected record layout.");
+
+const char binary_coll_magic[8] = "SUDCOLL";
+
+/// Converts an entry of the collection to a record.
+inline BinarySudRecord to_binary_record(const SudokuCollection::Entry & e, const sud_char_t & desc) {
+	BinarySudRecord rec;
+	std::memset(&rec, 0, sizeof(rec));
+	rec.sud = e.sud;
+	rec.sol = e.sol;
+	rec.lvl = (std::uint8_t)get_sud_char_level(desc);
+	rec.n_filled = (std::uint8_t)std::stoi(desc.substr(1, 2));
+	for (sudoku_size_t i = 0; i < side_len && 3 + i < (sudoku_size_t)desc.size(); ++i) {
+		rec.freq[i] = (std::uint8_t)(desc[3 + i] - '0');
+	}
+	return rec;
+}
+
+/// Reconstructs the description of a record, see \ref generate_sud_char().
+inline sud_char_t get_record_desc(const BinarySudRecord & rec) {
+	sud_char_t res = std::to_string(rec.lvl);
+	if (rec.n_filled < 10) {
+		res += "0";
+	}
+	res += std::to_string(rec.n_filled);
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
+		res += std::to_string(rec.freq[i]);
+	}
+	return res;
+}
+
+/// Saves the collection in the binary format.
+///
+/// Fails without writing anything if a sudoku has a level of at least
+/// \ref binary_coll_max_lvl, which the level index cannot hold.
+inline bool save_coll_binary(const sud_coll_t & sud_map, const std::string & f_path) {
+
+	// Check that every sudoku fits into the level index
+	std::size_t n_indexed = 0;
+	for (std::uint32_t lvl = 0; lvl < binary_coll_max_lvl; ++lvl) {
+		n_indexed += sud_map.with_level(lvl).size();
+	}
+	if (n_indexed != sud_map.size()) {
+		std::cout << sud_map.size() - n_indexed << " sudokus have a level above " << binary_coll_max_lvl - 1
+			<< ", not saving " << f_path << "\n";
+		return false;
+	}
+
+	BinaryCollHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, binary_coll_magic, sizeof(header.magic));
+	header.version = binary_coll_version;
+	header.record_size = sizeof(BinarySudRecord);
+
+	std::ofstream f(f_path, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		std::cout << "Could not open " << f_path << "\n";
+		return false;
+	}
+	f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	// Write the records sorted by level
+	for (std::uint32_t lvl = 0; lvl < binary_coll_max_lvl; ++lvl) {
+		header.lvl_begin[lvl] = header.n_records;
+		for (const auto ind : sud_map.with_level(lvl)) {
+			const BinarySudRecord rec = to_binary_record(sud_map.get_entry(ind), sud_map.get_desc(ind));
+			f.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+			++header.lvl_count[lvl];
+			++header.n_records;
+		}
+	}
+
+	// Rewrite the header with the index
+	f.seekp(0);
+	f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	return (bool)f;
+}
+
+/// Read-only memory mapping of a whole file.
+class MappedFile {
+
+public:
+	MappedFile() {};
+
+	/// Maps the file 'f_path', check \ref is_open() for success.
+	explicit MappedFile(const std::string & f_path) {
+		open(f_path);
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	/// Maps the file 'f_path', returns false on failure.
+	bool open(const std::string & f_path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(f_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER f_size;
+		if (!GetFileSizeEx(file, &f_size) || f_size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		ptr = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		n_bytes = (std::size_t)f_size.QuadPart;
+#else
+		const int fd = ::open(f_path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void * p = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED) {
+			return false;
+		}
+		madvise(p, (std::size_t)st.st_size, MADV_WILLNEED);
+		ptr = static_cast<const char *>(p);
+		n_bytes = (std::size_t)st.st_size;
+#endif
+		if (ptr == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	/// Unmaps the file.
+	void close() {
+#ifdef _WIN32
+		if (ptr != nullptr) UnmapViewOfFile(ptr);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (ptr != nullptr) munmap(const_cast<char *>(ptr), n_bytes);
+#endif
+		ptr = nullptr;
+		n_bytes = 0;
+	}
+
+	bool is_open() const {
+		return ptr != nullptr;
+	}
+
+	const char * data() const {
+		return ptr;
+	}
+
+	std::size_t size() const {
+		return n_bytes;
+	}
+
+private:
+	const char * ptr = nullptr;
+	std::size_t n_bytes = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
+
+/// A binary collection file mapped into memory.
+///
+/// The records are served directly from the mapping, nothing is parsed
+/// or copied when opening.
+class MappedCollection {
+
+public:
+	/// Opens the binary collection 'f_path', check \ref is_open() for success.
+	explicit MappedCollection(const std::string & f_path) {
+		if (!file.open(f_path)) {
+			std::cout << "Could not map " << f_path << "\n";
+			return;
+		}
+		if (file.size() < sizeof(BinaryCollHeader)) {
+			std::cout << "File too small: " << f_path << "\n";
+			file.close();
+			return;
+		}
+		header = reinterpret_cast<const BinaryCollHeader *>(file.data());
+		if (!is_valid_header(*header, file.size())) {
+			std::cout << "Invalid binary collection: " << f_path << "\n";
+			file.close();
+			header = nullptr;
+			return;
+		}
+		records = reinterpret_cast<const BinarySudRecord *>(file.data() + sizeof(BinaryCollHeader));
+	}
+
+	bool is_open() const {
+		return header != nullptr;
+	}
+
+	/// Number of records.
+	std::size_t size() const {
+		return is_open() ? (std::size_t)header->n_records : 0;
+	}
+
+	/// Returns the record with index 'ind'.
+	const BinarySudRecord & record(const std::size_t ind) const {
+		return records[ind];
+	}
+
+	/// Returns the sudoku and its solution with index 'ind'.
+	sud_and_sol_t get(const std::size_t ind) const {
+		return std::make_pair(unpack_sudoku(records[ind].sud.data()), unpack_sudoku(records[ind].sol.data()));
+	}
+
+	/// Returns pointers to the first and behind the last record of level 'lvl'.
+	std::pair<const BinarySudRecord *, const BinarySudRecord *> level_range(const rec_depth_t lvl) const {
+		if (!is_open() || lvl < 0 || lvl >= (rec_depth_t)binary_coll_max_lvl) {
+			return std::make_pair(records, records);
+		}
+		const BinarySudRecord * beg = records + header->lvl_begin[lvl];
+		return std::make_pair(beg, beg + header->lvl_count[lvl]);
+	}
+
+private:
+	/// Checks the header of a file with 'n_bytes' bytes, including the level index.
+	static bool is_valid_header(const BinaryCollHeader & h, const std::size_t n_bytes) {
+		if (std::memcmp(h.magic, binary_coll_magic, sizeof(h.magic)) != 0
+			|| h.version != binary_coll_version
+			|| h.record_size != sizeof(BinarySudRecord)
+			|| h.n_records > (n_bytes - sizeof(BinaryCollHeader)) / sizeof(BinarySudRecord)) {
+			return false;
+		}
+		for (std::uint32_t lvl = 0; lvl < binary_coll_max_lvl; ++lvl) {
+			if (h.lvl_begin[lvl] > h.n_records || h.lvl_count[lvl] > h.n_records - h.lvl_begin[lvl]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	MappedFile file;
+	const BinaryCollHeader * header = nullptr;
+	const BinarySudRecord * records = nullptr;
+};
+
+/// Loads a binary collection file into a collection.
+inline sud_coll_t load_coll_binary(const std::string & f_path) {
+	sud_coll_t sud_map;
+	const MappedCollection m_coll(f_path);
+	sud_map.reserve(m_coll.size());
+	for (std::size_t i = 0; i < m_coll.size(); ++i) {
+		const auto[s, sol] = m_coll.get(i);
+		sud_map.add(get_record_desc(m_coll.record(i)), s, sol, std::numeric_limits<num_sud_t>::max());
+	}
+	return sud_map;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Canonical Form
+//
+// Two sudokus are equivalent if one can be transformed into the other by
+// relabeling the numbers, permuting the rows inside a band, the columns inside
+// a stack, the bands, the stacks and by transposing. The canonical form is the
+// lexicographically smallest equivalent sudoku where the numbers are relabeled
+// in the order of their first appearance. Empty cells (0) are kept.
+
+/// Number of bands (groups of square_height rows).
+constexpr sudoku_size_t n_bands = side_len / square_height;
+
+/// Number of stacks (groups of square_width columns).
+constexpr sudoku_size_t n_stacks = side_len / square_width;
+
+/// A permutation of the rows or the columns.
+typedef std::array<sudoku_size_t, side_len> line_perm_t;
+
+/// Canonical representative and its hash.
+struct CanonicalForm {
+	raw_sudoku_t sudoku; ///< The canonical sudoku.
+	std::uint64_t hash; ///< Hash of the canonical sudoku.
+};
+
+/// Hashes a raw sudoku (FNV-1a).
+inline std::uint64_t hash_raw_sudoku(const raw_sudoku_t & s) {
+	std::uint64_t h = 14695981039346656037ull;
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		h ^= (std::uint64_t)s[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/// Returns all permutations of {0, ... , n - 1}.
+inline std::vector<std::vector<sudoku_size_t> > all_permutations(const sudoku_size_t n) {
+	std::vector<sudoku_size_t> p(n);
+	for (sudoku_size_t i = 0; i < n; ++i) {
+		p[i] = i;
+	}
+	std::vector<std::vector<sudoku_size_t> > perms;
+	do {
+		perms.push_back(p);
+	} while (std::next_permutation(p.begin(), p.end()));
+	return perms;
+}
+
+/// Returns all column permutations that keep the stacks intact.
+///
+/// Computed once, there are n_stacks! * (square_width!)^n_stacks of them.
+inline const std::vector<line_perm_t> & get_column_maps() {
+	static const std::vector<line_perm_t> col_maps = []() {
+		const auto stack_perms = all_permutations(n_stacks);
+		const auto inner_perms = all_permutations(square_width);
+		std::vector<line_perm_t> maps;
+		std::vector<std::size_t> inner_ind(n_stacks, 0);
+		for (const auto& sp : stack_perms) {
+			std::fill(inner_ind.begin(), inner_ind.end(), 0);
+			bool done = false;
+			while (!done) {
+				line_perm_t m;
+				for (sudoku_size_t k = 0; k < n_stacks; ++k) {
+					for (sudoku_size_t i = 0; i < square_width; ++i) {
+						m[k * square_width + i] = sp[k] * square_width + inner_perms[inner_ind[k]][i];
+					}
+				}
+				maps.push_back(m);
+
+				// Next combination of permutations inside the stacks
+				done = true;
+				for (sudoku_size_t k = 0; k < n_stacks; ++k) {
+					if (++inner_ind[k] < inner_perms.size()) {
+						done = false;
+						break;
+					}
+					inner_ind[k] = 0;
+				}
+			}
+		}
+		return maps;
+	}();
+	return col_maps;
+}
+
+/// State of the canonical form search.
+struct CanonSearchState {
+	const raw_sudoku_t * grid; ///< Possibly transposed input.
+	const line_perm_t * col_map; ///< Column permutation.
+	std::array<sudoku_value_t, side_len + 1> label; ///< Relabeling of numbers, 0 if not yet seen.
+	sudoku_value_t next_label; ///< The next label to be assigned.
+	std::array<bool, n_bands> band_used; ///< Bands that were already placed.
+	std::array<bool, square_height> row_used; ///< Rows of the current band already placed.
+	sudoku_size_t curr_band; ///< The band that is currently being placed.
+};
+
+/// Compares the relabeled row 'src_row' with row 'out_row' of 'best'.
+///
+/// Returns -1 if it is smaller, 0 if equal and 1 if larger. If it is not
+/// larger the labels in 'state' are updated and the row is stored in 'row'.
+inline int canon_eval_row(CanonSearchState & state, const sudoku_size_t src_row,
+	const raw_sudoku_t & best, const sudoku_size_t out_row, line_perm_t & row) {
+
+	std::array<sudoku_value_t, side_len + 1> label = state.label;
+	sudoku_value_t next_label = state.next_label;
+	int cmp = 0;
+	for (sudoku_size_t c = 0; c < side_len; ++c) {
+		const sudoku_value_t v = (*state.grid)[src_row * side_len + (*state.col_map)[c]];
+		if (v > 0 && label[v] == 0) {
+			label[v] = next_label++;
+		}
+		row[c] = label[v];
+		if (cmp == 0) {
+			const sudoku_value_t b = best[out_row * side_len + c];
+			if (row[c] > b) {
+				return 1;
+			}
+			if (row[c] < b) {
+				cmp = -1;
+			}
+		}
+	}
+	state.label = label;
+	state.next_label = next_label;
+	return cmp;
+}
+
+/// Recursively places the rows 'out_row', ... while the result can still beat 'best'.
+///
+/// Invariant: The rows above 'out_row' are equal to the ones in 'best'.
+/// If a smaller row is found, it is written to 'best' and all rows below
+/// are invalidated, so they will be overwritten further down.
+inline void canon_place_rows(const CanonSearchState & state, const sudoku_size_t out_row, raw_sudoku_t & best) {
+	if (out_row == side_len) {
+		return;
+	}
+
+	const bool new_band = out_row % square_height == 0;
+	for (sudoku_size_t band = 0; band < n_bands; ++band) {
+		if (new_band ? state.band_used[band] : band != state.curr_band) {
+			continue;
+		}
+		for (sudoku_size_t r = 0; r < square_height; ++r) {
+			if (!new_band && state.row_used[r]) {
+				continue;
+			}
+			CanonSearchState next = state;
+			if (new_band) {
+				next.band_used[band] = true;
+				next.curr_band = band;
+				std::fill(next.row_used.begin(), next.row_used.end(), false);
+			}
+			next.row_used[r] = true;
+
+			line_perm_t row;
+			const int cmp = canon_eval_row(next, band * square_height + r, best, out_row, row);
+			if (cmp > 0) {
+				continue;
+			}
+			if (cmp < 0) {
+				std::copy(row.begin(), row.end(), best.begin() + out_row * side_len);
+				std::fill(best.begin() + (out_row + 1) * side_len, best.end(), side_len + 1);
+			}
+			canon_place_rows(next, out_row + 1, best);
+		}
+	}
+}
+
+/// Computes the canonical form of the sudoku 's'.
+///
+/// Works for complete grids and for puzzles.
+inline CanonicalForm canonicalize(const raw_sudoku_t & s) {
+
+	// Start with a representative that is larger than everything
+	raw_sudoku_t best;
+	std::fill(best.begin(), best.end(), side_len + 1);
+
+	raw_sudoku_t s_trans;
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
+		for (sudoku_size_t k = 0; k < side_len; ++k) {
+			s_trans[i * side_len + k] = s[k * side_len + i];
+		}
+	}
+	const sudoku_size_t n_transpose = square_height == square_width ? 2 : 1;
+
+	CanonSearchState state;
+	std::fill(state.label.begin(), state.label.end(), 0);
+	state.next_label = 1;
+	std::fill(state.band_used.begin(), state.band_used.end(), false);
+	std::fill(state.row_used.begin(), state.row_used.end(), false);
+	state.curr_band = 0;
+
+	for (sudoku_size_t t = 0; t < n_transpose; ++t) {
+		state.grid = t == 0 ? &s : &s_trans;
+		for (const line_perm_t & col_map : get_column_maps()) {
+			state.col_map = &col_map;
+			canon_place_rows(state, 0, best);
+		}
+	}
+
+	CanonicalForm res;
+	res.sudoku = best;
+	res.hash = hash_raw_sudoku(best);
+	return res;
+}
+
+/// Checks if the sudokus 's1' and 's2' are equivalent.
+inline bool are_equivalent(const raw_sudoku_t & s1, const raw_sudoku_t & s2) {
+	return canonicalize(s1).sudoku == canonicalize(s2).sudoku;
+}
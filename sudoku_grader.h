@@ -0,0 +1,515 @@
+#pragma once
+
+#include "sudoku_lanes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Human-Style Grading
+//
+// Rates a sudoku by the hardest logical technique a human needs to solve it,
+// instead of the recursion depth of the search. The techniques are tried in
+// the order of their rating, after every successful step the grader starts
+// again with the cheapest one. All instances of a technique found in one
+// sweep are applied together and counted separately. The candidates are
+// stored as bitmasks, see \ref cand_mask_t, so a sweep is a few hundred
+// mask operations. Sudokus that cannot be solved without guessing get the
+// rating \ref search_rating. The chains are those of \ref find_chain_eliminations().
+
+/// The techniques of the grader, in the order they are tried.
+enum GradeTechnique {
+	GradeHiddenSingle, ///< Number possible in only one cell of a unit, as \ref find_unique_in_rcs().
+	GradeNakedSingle, ///< Cell with only one possible number, as \ref find_single_number_cell().
+	GradePointing, ///< Number of a square restricted to one row or col, as \ref eliminate_possible_numbers_squares().
+	GradeClaiming, ///< Number of a row or col restricted to one square, as \ref eliminate_possible_numbers_rows().
+	GradeNakedPair, ///< Two cells of a unit with the same two possible numbers.
+	GradeXWing, ///< Number restricted to the same two cols in two rows, or vice versa.
+	GradeHiddenPair, ///< Two numbers restricted to the same two cells of a unit.
+	GradeNakedTriple, ///< Three cells of a unit with three possible numbers together.
+	GradeSwordfish, ///< X-wing with three rows and cols.
+	GradeHiddenTriple, ///< Three numbers restricted to the same three cells of a unit.
+	GradeXYWing, ///< See \ref find_xy_wings().
+	GradeXYZWing, ///< See \ref find_xyz_wings().
+	GradeSimpleColoring, ///< See \ref find_simple_coloring().
+	GradeNakedQuad, ///< Four cells of a unit with four possible numbers together.
+	GradeHiddenQuad, ///< Four numbers restricted to the same four cells of a unit.
+	GradeAic, ///< Alternating inference chain, see \ref find_aic().
+};
+
+/// Number of \ref GradeTechnique.
+constexpr int n_grade_techniques = 16;
+
+/// String array mapping each \ref GradeTechnique to its name.
+const std::string grade_technique_names[n_grade_techniques] = { "hidden_single", "naked_single", "pointing",
+	"claiming", "naked_pair", "x_wing", "hidden_pair", "naked_triple", "swordfish", "hidden_triple", "xy_wing",
+	"xyz_wing", "simple_coloring", "naked_quad", "hidden_quad", "aic" };
+
+/// Rating of each \ref GradeTechnique, on the scale of Sudoku Explainer.
+const double grade_technique_ratings[n_grade_techniques] = { 1.5, 2.3, 2.6, 2.8, 3.0, 3.2, 3.4, 3.6, 3.8, 4.0,
+	4.2, 4.4, 4.5, 5.0, 5.4, 6.0 };
+
+/// Rating of sudokus that need guessing.
+constexpr double search_rating = 10.0;
+
+/// Outcome of grading a sudoku.
+enum GradeStatus {
+	GradeSolved, ///< Solved by the techniques.
+	GradeNeedsSearch, ///< The techniques got stuck, guessing is needed.
+	GradeInvalid, ///< Contradiction found, the sudoku has no solution.
+};
+
+/// String array mapping each \ref GradeStatus to its name.
+const std::string grade_status_names[] = { "solved", "needs_search", "invalid" };
+
+/// Result of grading a sudoku.
+struct GradeResult {
+	GradeStatus status = GradeSolved; ///< Outcome.
+	double rating = 0.0; ///< Rating of the hardest technique, \ref search_rating if guessing is needed.
+	int hardest = -1; ///< Hardest \ref GradeTechnique used, -1 if none.
+	int n_steps = 0; ///< Number of successful sweeps.
+	std::array<int, n_grade_techniques> n_applied = {}; ///< Applications per technique.
+	raw_sudoku_t grid; ///< State reached, the solution if solved.
+};
+
+/// Prints the result as 'status,rating,hardest'.
+inline std::ostream& operator<<(std::ostream & os, const GradeResult & res) {
+	os << grade_status_names[res.status] << "," << res.rating << ","
+		<< (res.hardest >= 0 ? grade_technique_names[res.hardest] : "none");
+	return os;
+}
+
+/// State of the grader: Numbers set and candidates of all cells.
+struct GradeGrid {
+	std::array<cand_mask_t, tot_num_cells> cand; ///< Candidates, a single bit for set cells.
+	std::array<sudoku_value_t, tot_num_cells> value; ///< Number set, 0 if open.
+	int n_open; ///< Number of open cells.
+};
+
+/// Sets the number 'v' in the cell 'c' and removes it from all peers.
+inline void grade_place(GradeGrid & g, const sudoku_size_t c, const sudoku_value_t v) {
+	const SudokuUnits & units = get_units();
+	const cand_mask_t bit = (cand_mask_t)(1 << (v - 1));
+	g.value[c] = v;
+	g.cand[c] = bit;
+	--g.n_open;
+	for (const sudoku_size_t p : units.peers[c]) {
+		g.cand[p] &= (cand_mask_t)~bit;
+	}
+}
+
+/// Removes the candidates 'm' from the open cell 'c', returns true if any was possible.
+inline bool grade_eliminate(GradeGrid & g, const sudoku_size_t c, const cand_mask_t m) {
+	if (g.value[c] != 0 || (g.cand[c] & m) == 0) {
+		return false;
+	}
+	g.cand[c] &= (cand_mask_t)~m;
+	return true;
+}
+
+/// Initializes the grid with a raw sudoku, returns false if the givens contradict each other.
+inline bool init_grade_grid(GradeGrid & g, const raw_sudoku_t & s) {
+	g.cand.fill(all_cands);
+	g.value.fill(0);
+	g.n_open = tot_num_cells;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (s[c] == 0) continue;
+		if (s[c] < 0 || s[c] > side_len || (g.cand[c] & (1 << (s[c] - 1))) == 0) {
+			return false;
+		}
+		grade_place(g, c, s[c]);
+	}
+	return true;
+}
+
+/// Checks that every open cell has a candidate and every unit can hold every number.
+inline bool grade_consistent(const GradeGrid & g) {
+	const SudokuUnits & units = get_units();
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (g.cand[c] == 0) return false;
+	}
+	for (const auto& u_cells : units.cells) {
+		cand_mask_t any = 0;
+		for (const sudoku_size_t c : u_cells) {
+			any |= g.cand[c];
+		}
+		if (any != all_cands) return false;
+	}
+	return true;
+}
+
+/// Calls 'f(idx)' for all 'k'-subsets 'idx[0, k)' of [0, n), k <= 4.
+template<typename Func>
+void for_each_subset(const int n, const int k, Func && f) {
+	if (k > n) {
+		return;
+	}
+	std::array<int, 4> idx;
+	for (int i = 0; i < k; ++i) {
+		idx[i] = i;
+	}
+	while (true) {
+		f(idx);
+		int i = k - 1;
+		while (i >= 0 && idx[i] == n - k + i) {
+			--i;
+		}
+		if (i < 0) {
+			return;
+		}
+		++idx[i];
+		for (int j = i + 1; j < k; ++j) {
+			idx[j] = idx[j - 1] + 1;
+		}
+	}
+}
+
+/// Places all hidden singles, returns the number of placements.
+inline int grade_hidden_singles(GradeGrid & g) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (const auto& u_cells : units.cells) {
+		cand_mask_t once = 0, twice = 0, set = 0;
+		for (const sudoku_size_t c : u_cells) {
+			if (g.value[c] != 0) {
+				set |= g.cand[c];
+				continue;
+			}
+			twice |= once & g.cand[c];
+			once |= g.cand[c];
+		}
+		const cand_mask_t hidden = once & (cand_mask_t)~twice & (cand_mask_t)~set;
+		if (hidden == 0) continue;
+		for (const sudoku_size_t c : u_cells) {
+			const cand_mask_t m = g.cand[c] & hidden;
+			if (g.value[c] == 0 && m != 0 && count_cands(m) == 1) {
+				grade_place(g, c, mask_to_number(m));
+				++n_found;
+			}
+		}
+	}
+	return n_found;
+}
+
+/// Places all naked singles, returns the number of placements.
+inline int grade_naked_singles(GradeGrid & g) {
+	int n_found = 0;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (g.value[c] == 0 && g.cand[c] != 0 && count_cands(g.cand[c]) == 1) {
+			grade_place(g, c, mask_to_number(g.cand[c]));
+			++n_found;
+		}
+	}
+	return n_found;
+}
+
+/// Applies pointing ('from_squares') or claiming, returns the number of productive instances.
+///
+/// If all cells of unit 'u' where a number is possible lie in one other
+/// unit, the number is eliminated from the rest of that unit.
+inline int grade_locked_candidates(GradeGrid & g, const bool from_squares) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	const sudoku_size_t u_beg = from_squares ? 2 * side_len : 0;
+	const sudoku_size_t u_end = from_squares ? 3 * side_len : 2 * side_len;
+	for (sudoku_size_t u = u_beg; u < u_end; ++u) {
+		for (sudoku_value_t d = 0; d < side_len; ++d) {
+			const cand_mask_t bit = (cand_mask_t)(1 << d);
+
+			// The units that contain all cells of 'u' where 'd' is possible
+			int n_cells = 0;
+			sudoku_size_t common[2] = { -1, -1 };
+			bool in_common[2] = { true, true };
+			for (const sudoku_size_t c : units.cells[u]) {
+				if (g.value[c] == d + 1) {
+					n_cells = 0;
+					break;
+				}
+				if (g.value[c] != 0 || (g.cand[c] & bit) == 0) continue;
+				const auto& of_c = units.of_cell[c];
+				const sudoku_size_t other[2] = { from_squares ? of_c[0] : of_c[2], from_squares ? of_c[1] : of_c[2] };
+				for (int t = 0; t < 2; ++t) {
+					if (n_cells == 0) common[t] = other[t];
+					in_common[t] = in_common[t] && common[t] == other[t];
+				}
+				++n_cells;
+			}
+			if (n_cells < 2) continue;
+
+			// Eliminate
+			for (int t = 0; t < (from_squares ? 2 : 1); ++t) {
+				if (!in_common[t]) continue;
+				bool productive = false;
+				for (const sudoku_size_t c : units.cells[common[t]]) {
+					if (units.of_cell[c][u / side_len] != u) {
+						productive = grade_eliminate(g, c, bit) || productive;
+					}
+				}
+				n_found += productive;
+			}
+		}
+	}
+	return n_found;
+}
+
+/// Applies naked subsets of size 'k', returns the number of productive instances.
+inline int grade_naked_subsets(GradeGrid & g, const int k) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (const auto& u_cells : units.cells) {
+		std::array<sudoku_size_t, side_len> open;
+		int n_open = 0;
+		for (const sudoku_size_t c : u_cells) {
+			const int n_c = count_cands(g.cand[c]);
+			if (g.value[c] == 0 && n_c >= 2 && n_c <= k) open[n_open++] = c;
+		}
+		for_each_subset(n_open, k, [&](const std::array<int, 4> & idx) {
+			cand_mask_t nums = 0;
+			for (int i = 0; i < k; ++i) {
+				nums |= g.cand[open[idx[i]]];
+			}
+			if (count_cands(nums) != k) return;
+			bool productive = false;
+			for (const sudoku_size_t c : u_cells) {
+				bool in_subset = false;
+				for (int i = 0; i < k; ++i) {
+					in_subset = in_subset || open[idx[i]] == c;
+				}
+				if (!in_subset) productive = grade_eliminate(g, c, nums) || productive;
+			}
+			n_found += productive;
+		});
+	}
+	return n_found;
+}
+
+/// Applies hidden subsets of size 'k', returns the number of productive instances.
+inline int grade_hidden_subsets(GradeGrid & g, const int k) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (const auto& u_cells : units.cells) {
+
+		// Positions of each number in the unit
+		std::array<cand_mask_t, side_len> pos = {};
+		for (sudoku_size_t i = 0; i < side_len; ++i) {
+			const sudoku_size_t c = u_cells[i];
+			for (sudoku_value_t d = 0; d < side_len; ++d) {
+				if (g.value[c] == d + 1) {
+					pos[d] = all_cands;
+				}
+				else if (g.value[c] == 0 && (g.cand[c] >> d) & 1) {
+					pos[d] |= (cand_mask_t)(1 << i);
+				}
+			}
+		}
+		std::array<sudoku_value_t, side_len> nums;
+		int n_nums = 0;
+		for (sudoku_value_t d = 0; d < side_len; ++d) {
+			const int n_pos = count_cands(pos[d]);
+			if (pos[d] != all_cands && n_pos >= 2 && n_pos <= k) nums[n_nums++] = d;
+		}
+
+		for_each_subset(n_nums, k, [&](const std::array<int, 4> & idx) {
+			cand_mask_t cells = 0, keep = 0;
+			for (int i = 0; i < k; ++i) {
+				cells |= pos[nums[idx[i]]];
+				keep |= (cand_mask_t)(1 << nums[idx[i]]);
+			}
+			if (count_cands(cells) != k) return;
+			bool productive = false;
+			for (sudoku_size_t i = 0; i < side_len; ++i) {
+				if ((cells >> i) & 1) productive = grade_eliminate(g, u_cells[i], (cand_mask_t)~keep & all_cands) || productive;
+			}
+			n_found += productive;
+		});
+	}
+	return n_found;
+}
+
+/// Applies fish with 'k' base rows or cols, returns the number of productive instances.
+///
+/// If a number is possible in 'k' rows only within the same 'k' cols, it is
+/// eliminated from the rest of these cols, and vice versa.
+inline int grade_fish(GradeGrid & g, const int k) {
+	const SudokuUnits & units = get_units();
+	int n_found = 0;
+	for (sudoku_value_t d = 0; d < side_len; ++d) {
+		const cand_mask_t bit = (cand_mask_t)(1 << d);
+		for (int base_type = 0; base_type < 2; ++base_type) {
+
+			// Positions of the number in each base unit, the index within the
+			// base unit is the index of the cover unit
+			std::array<cand_mask_t, side_len> pos;
+			std::array<sudoku_size_t, side_len> bases;
+			int n_bases = 0;
+			for (sudoku_size_t b = 0; b < side_len; ++b) {
+				const auto& b_cells = units.cells[base_type * side_len + b];
+				cand_mask_t m = 0;
+				bool is_set = false;
+				for (sudoku_size_t i = 0; i < side_len; ++i) {
+					is_set = is_set || g.value[b_cells[i]] == d + 1;
+					if (g.value[b_cells[i]] == 0 && (g.cand[b_cells[i]] & bit)) m |= (cand_mask_t)(1 << i);
+				}
+				const int n_pos = count_cands(m);
+				if (!is_set && n_pos >= 2 && n_pos <= k) {
+					pos[n_bases] = m;
+					bases[n_bases++] = b;
+				}
+			}
+
+			for_each_subset(n_bases, k, [&](const std::array<int, 4> & idx) {
+				cand_mask_t covers = 0, base_set = 0;
+				for (int i = 0; i < k; ++i) {
+					covers |= pos[idx[i]];
+					base_set |= (cand_mask_t)(1 << bases[idx[i]]);
+				}
+				if (count_cands(covers) != k) return;
+				bool productive = false;
+				for (sudoku_size_t i = 0; i < side_len; ++i) {
+					if (((covers >> i) & 1) == 0) continue;
+					const auto& c_cells = units.cells[(1 - base_type) * side_len + i];
+					for (sudoku_size_t j = 0; j < side_len; ++j) {
+						if (((base_set >> j) & 1) == 0) productive = grade_eliminate(g, c_cells[j], bit) || productive;
+					}
+				}
+				n_found += productive;
+			});
+		}
+	}
+	return n_found;
+}
+
+/// Applies the chain technique 'tech' to the open cells, returns the number of instances.
+inline int grade_chains(GradeGrid & g, const ChainTechnique tech) {
+	cand_grid_t cands;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		cands[c] = g.value[c] == 0 ? g.cand[c] : 0;
+	}
+	const int n_found = apply_chain_technique(cands, tech);
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		if (g.value[c] == 0) g.cand[c] = cands[c];
+	}
+	return n_found;
+}
+
+/// Applies all instances of the technique 't', returns their number.
+inline int grade_apply(GradeGrid & g, const GradeTechnique t) {
+	switch (t) {
+	case GradeHiddenSingle: return grade_hidden_singles(g);
+	case GradeNakedSingle: return grade_naked_singles(g);
+	case GradePointing: return grade_locked_candidates(g, true);
+	case GradeClaiming: return grade_locked_candidates(g, false);
+	case GradeNakedPair: return grade_naked_subsets(g, 2);
+	case GradeXWing: return grade_fish(g, 2);
+	case GradeHiddenPair: return grade_hidden_subsets(g, 2);
+	case GradeNakedTriple: return grade_naked_subsets(g, 3);
+	case GradeSwordfish: return grade_fish(g, 3);
+	case GradeHiddenTriple: return grade_hidden_subsets(g, 3);
+	case GradeXYWing: return grade_chains(g, ChainXYWing);
+	case GradeXYZWing: return grade_chains(g, ChainXYZWing);
+	case GradeSimpleColoring: return grade_chains(g, ChainSimpleColoring);
+	case GradeNakedQuad: return grade_naked_subsets(g, 4);
+	case GradeHiddenQuad: return grade_hidden_subsets(g, 4);
+	case GradeAic: return grade_chains(g, ChainAic);
+	}
+	return 0;
+}
+
+/// Grades the raw sudoku with the techniques up to 'max_tech'.
+inline GradeResult grade_sudoku(const raw_sudoku_t & s, const int max_tech = n_grade_techniques - 1) {
+	GradeResult res;
+	GradeGrid g;
+	if (!init_grade_grid(g, s)) {
+		res.status = GradeInvalid;
+		res.grid = s;
+		return res;
+	}
+
+	while (g.n_open > 0) {
+		if (!grade_consistent(g)) {
+			res.status = GradeInvalid;
+			break;
+		}
+
+		// Cheapest technique that makes progress
+		int n_found = 0;
+		int t = 0;
+		for (; t <= max_tech && n_found == 0; ++t) {
+			n_found = grade_apply(g, (GradeTechnique)t);
+		}
+		if (n_found == 0) {
+			res.status = GradeNeedsSearch;
+			res.rating = search_rating;
+			break;
+		}
+		--t;
+		res.n_applied[t] += n_found;
+		++res.n_steps;
+		if (t > res.hardest) {
+			res.hardest = t;
+			res.rating = grade_technique_ratings[t];
+		}
+	}
+	if (res.status == GradeSolved && !grade_consistent(g)) {
+		res.status = GradeInvalid;
+	}
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		res.grid[c] = g.value[c];
+	}
+	return res;
+}
+
+/// Statistics of a graded batch.
+struct GradeStats {
+	std::array<std::uint64_t, 3> n_status = {}; ///< Sudokus per \ref GradeStatus.
+	std::array<std::uint64_t, n_grade_techniques> n_hardest = {}; ///< Solved sudokus per hardest technique.
+	std::array<std::uint64_t, n_grade_techniques> n_applied = {}; ///< Total applications per technique.
+
+	/// Adds the result of one sudoku.
+	void add(const GradeResult & res) {
+		++n_status[res.status];
+		if (res.status == GradeSolved && res.hardest >= 0) {
+			++n_hardest[res.hardest];
+		}
+		for (int t = 0; t < n_grade_techniques; ++t) {
+			n_applied[t] += res.n_applied[t];
+		}
+	}
+};
+
+/// Prints the statistics as a table.
+inline std::ostream& operator<<(std::ostream & os, const GradeStats & stats) {
+	for (int s = 0; s < 3; ++s) {
+		os << grade_status_names[s] << ": " << stats.n_status[s] << "\n";
+	}
+	os << "technique,rating,hardest,applied\n";
+	for (int t = 0; t < n_grade_techniques; ++t) {
+		os << grade_technique_names[t] << "," << grade_technique_ratings[t] << "," << stats.n_hardest[t]
+			<< "," << stats.n_applied[t] << "\n";
+	}
+	return os;
+}
+
+/// Grades 'suds[0, n)' on the pool and writes 'results[0, n)'.
+///
+/// Returns the statistics of all sudokus, each worker collects its own
+/// statistics that are merged at the end.
+inline GradeStats grade_batch(WorkStealingPool & pool, const raw_sudoku_t * suds, const std::size_t n,
+	GradeResult * results, const std::size_t chunk_size = 64) {
+	std::vector<GradeStats> per_worker(pool.num_workers());
+	pool.parallel_for(n, chunk_size, [&](const std::size_t beg, const std::size_t end, const unsigned int worker_id) {
+		for (std::size_t i = beg; i < end; ++i) {
+			results[i] = grade_sudoku(suds[i]);
+			per_worker[worker_id].add(results[i]);
+		}
+	});
+
+	GradeStats res;
+	for (const auto& st : per_worker) {
+		for (int s = 0; s < 3; ++s) {
+			res.n_status[s] += st.n_status[s];
+		}
+		for (int t = 0; t < n_grade_techniques; ++t) {
+			res.n_hardest[t] += st.n_hardest[t];
+			res.n_applied[t] += st.n_applied[t];
+		}
+	}
+	return res;
+}
@@ -736,20 +736,31 @@ class SudokuHandler {
 	}
 
 	/// Find a solution and check if it is unique
-	template<bool random_order = False, bool printDebugInfo = printRecDebInfo,
+	template<bool random_order = false, bool printDebugInfo = printRecDebInfo,
 		typename RNG>
 	FullSol_t solve_brute_force_multiple_random(
 		sudoku_data_t & s_data,
 		RNG & rng, 
-		const rec_depth_t rec_dep = 0
+		const rec_depth_t rec_dep = 0,
+		SearchBudget * budget = nullptr
 	) {
 
+		if (budget && budget->enter_node()) {
+			return std::make_pair(budget->stop_result(), budget->cancelled ? -5 : -4);
+		}
+		TraceNode trace;
+
 		// Try solving 
+		trace.event(TracePropagateBegin);
 		SolveStepRes init_stat = try_solving(s_data);
+		trace.event(TracePropagateEnd);
 		if (init_stat == Invalid) {
+			trace.event(TraceContradiction);
 			return std::make_pair(InvalidSolution, rec_dep);
 		}
 		else if (solved(s_data)) {
+			trace.event(TraceSolution);
+			if (budget) ++budget->n_sols;
 			return std::make_pair(UniqueSolution, rec_dep);
 		}
 
@@ -781,15 +792,19 @@ class SudokuHandler {
 				// Copy data and set guessed value
 				s_data_copy = s_data;
 				s_data_copy[cell_picked] = curr_i + 1;
+				trace.event(TraceGuess, cell_picked / n_stored_per_cell, curr_i + 1);
 
 				// Recursion
 				auto[res, res_rd] = solve_brute_force_multiple_random<random_order, printDebugInfo>(
-					s_data_copy, rng, rec_dep + 1);
+					s_data_copy, rng, rec_dep + 1, budget);
+				if (res == TimeoutSolution || res == CancelledSolution) {
+					return std::make_pair(res, res_rd);
+				}
 				if (res == UniqueSolution) {
 					s_data_res = s_data_copy;
 					num_sols += 1;
 					if (curr_min_rd == -3 || res_rd < curr_min_rd) {
-						curr_min_rd = res;
+						curr_min_rd = res_rd;
 					}
 				}
 				if (num_sols > 1 || res == MultipleSolution) {
@@ -830,18 +845,21 @@ public:
 	}
 
 	/// Solves the loaded sudoku.
-	FullSol_t solve(bool random_order = false) {
+	///
+	/// If a budget is given and exceeded, returns \ref TimeoutSolution, if
+	/// its \ref CancelToken is cancelled \ref CancelledSolution.
+	FullSol_t solve(bool random_order = false, SearchBudget * budget = nullptr) {
 		
 		FullSol_t sol;
 
 		if (random_order) {
 			// Initialize rng and solve.
 			std::mt19937 gen = std::mt19937(seed);
-			sol = solve_brute_force_multiple_random<true>(sud_data, gen);
+			sol = solve_brute_force_multiple_random<true>(sud_data, gen, 0, budget);
 		}
 		else {
 			int rng = 0; // Dummy RNG.
-			sol = solve_brute_force_multiple_random<false>(sud_data, rng);
+			sol = solve_brute_force_multiple_random<false>(sud_data, rng, 0, budget);
 		}
 
 		return sol;
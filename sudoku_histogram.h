@@ -0,0 +1,217 @@
+#pragma once
+
+#include "sudoku_batch.h"
+
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Latency Histograms
+//
+// Log-linear histograms in the style of HdrHistogram: Values below 128 are
+// counted exactly, larger values in 64 buckets per power of two, i.e. with
+// a relative error below 1.6%. Each worker of the batch solver records into
+// its own histograms without any synchronization, they are merged when the
+// batch is done.
+
+/// Histogram of non-negative integer values with bounded relative error.
+class LogHistogram {
+
+public:
+	/// Number of exactly counted values.
+	static constexpr int n_linear = 128;
+
+	/// Buckets per power of two above \ref n_linear.
+	static constexpr int n_sub = n_linear / 2;
+
+	/// Total number of buckets.
+	static constexpr int n_buckets = n_linear + (64 - 7) * n_sub;
+
+	/// Counts the value 'v'.
+	void record(const std::uint64_t v) {
+		if (counts.empty()) {
+			counts.assign(n_buckets, 0);
+		}
+		++counts[bucket(v)];
+		++n_values;
+		total += v;
+		max_value = std::max(max_value, v);
+	}
+
+	/// Adds the counts of 'other'.
+	void merge(const LogHistogram & other) {
+		if (other.counts.empty()) {
+			return;
+		}
+		if (counts.empty()) {
+			counts.assign(n_buckets, 0);
+		}
+		for (int b = 0; b < n_buckets; ++b) {
+			counts[b] += other.counts[b];
+		}
+		n_values += other.n_values;
+		total += other.total;
+		max_value = std::max(max_value, other.max_value);
+	}
+
+	/// Number of recorded values.
+	std::uint64_t count() const {
+		return n_values;
+	}
+
+	/// Largest recorded value, exact.
+	std::uint64_t max() const {
+		return max_value;
+	}
+
+	double mean() const {
+		return n_values > 0 ? (double)total / n_values : 0.0;
+	}
+
+	/// Smallest value such that the fraction 'q' of all values is not larger.
+	///
+	/// Returns the upper end of the bucket, but at most \ref max().
+	std::uint64_t percentile(const double q) const {
+		if (n_values == 0) {
+			return 0;
+		}
+		const std::uint64_t rank = std::max<std::uint64_t>(1, (std::uint64_t)std::ceil(q * n_values));
+		std::uint64_t seen = 0;
+		for (int b = 0; b < n_buckets; ++b) {
+			seen += counts[b];
+			if (seen >= rank) {
+				return std::min(bucket_upper(b), max_value);
+			}
+		}
+		return max_value;
+	}
+
+private:
+	/// Index of the most significant set bit, v > 0.
+	static int msb(const std::uint64_t v) {
+#ifdef _MSC_VER
+		unsigned long ind;
+		_BitScanReverse64(&ind, v);
+		return (int)ind;
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+
+	static int bucket(const std::uint64_t v) {
+		if (v < (std::uint64_t)n_linear) {
+			return (int)v;
+		}
+		const int shift = msb(v) - 6;
+		return n_linear + (shift - 1) * n_sub + (int)((v >> shift) - n_sub);
+	}
+
+	static std::uint64_t bucket_upper(const int b) {
+		if (b < n_linear) {
+			return (std::uint64_t)b;
+		}
+		const int shift = (b - n_linear) / n_sub + 1;
+		const std::uint64_t sub = (std::uint64_t)((b - n_linear) % n_sub + n_sub);
+		return ((sub + 1) << shift) - 1;
+	}
+
+	std::vector<std::uint64_t> counts; // Allocated on first use
+	std::uint64_t n_values = 0;
+	std::uint64_t total = 0;
+	std::uint64_t max_value = 0;
+};
+
+/// Percentiles reported by \ref write_percentiles().
+const double report_percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+/// Histograms of one group of solved sudokus.
+struct SolveHistograms {
+	LogHistogram latency_ns; ///< Solve time in nanoseconds.
+	LogHistogram nodes; ///< Search nodes.
+	LogHistogram rounds; ///< Propagation rounds, see \ref propagation_rounds().
+
+	void merge(const SolveHistograms & other) {
+		latency_ns.merge(other.latency_ns);
+		nodes.merge(other.nodes);
+		rounds.merge(other.rounds);
+	}
+};
+
+/// Histograms of a batch, per level and in total.
+struct BatchHistograms {
+	std::map<rec_depth_t, SolveHistograms> per_lvl; ///< Per level.
+	SolveHistograms all; ///< All sudokus.
+};
+
+/// Writes p50, p90, p99, p99.9 and max of all histograms as CSV.
+///
+/// The level -1 denotes all sudokus.
+inline void write_percentiles(std::ostream & os, const BatchHistograms & hists) {
+	os << "level,metric,n,mean,p50,p90,p99,p99.9,max\n";
+	auto write_group = [&](const rec_depth_t lvl, const SolveHistograms & h) {
+		const std::pair<const char *, const LogHistogram *> metrics[] = {
+			{ "latency_ns", &h.latency_ns }, { "nodes", &h.nodes }, { "rounds", &h.rounds } };
+		for (const auto& m : metrics) {
+			os << lvl << "," << m.first << "," << m.second->count() << "," << m.second->mean();
+			for (const double q : report_percentiles) {
+				os << "," << m.second->percentile(q);
+			}
+			os << "," << m.second->max() << "\n";
+		}
+	};
+	for (const auto& lvl_h : hists.per_lvl) {
+		write_group(lvl_h.first, lvl_h.second);
+	}
+	write_group(-1, hists.all);
+}
+
+/// Like \ref solve_batch(), additionally records histograms per level.
+///
+/// 'lvls[i]' is the level of 'suds[i]', e.g. from the description of a
+/// collection, see \ref get_sud_char_level().
+inline BatchHistograms solve_batch_histograms(WorkStealingPool & pool, const raw_sudoku_t * suds,
+	const rec_depth_t * lvls, const std::size_t n, BatchResult * results, const BatchMode mode,
+	const int max_sols = 2, const SearchLimits & limits = SearchLimits()) {
+
+	std::vector<std::map<rec_depth_t, SolveHistograms> > per_worker(pool.num_workers());
+	pool.parallel_for(n, 16, [&](const std::size_t beg, const std::size_t end, const unsigned int worker_id) {
+		std::map<rec_depth_t, SolveHistograms> & hists = per_worker[worker_id];
+		for (std::size_t i = beg; i < end; ++i) {
+			const std::uint64_t rounds_before = propagation_rounds();
+			const auto t_start = std::chrono::steady_clock::now();
+			batch_solve_one(suds[i], mode, max_sols, results[i], limits);
+			const auto t_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t_start).count();
+
+			SolveHistograms & h = hists[lvls[i]];
+			h.latency_ns.record((std::uint64_t)t_ns);
+			h.nodes.record(results[i].n_nodes);
+			h.rounds.record(propagation_rounds() - rounds_before);
+		}
+	});
+
+	// Merge
+	BatchHistograms res;
+	for (const auto& hists : per_worker) {
+		for (const auto& lvl_h : hists) {
+			res.per_lvl[lvl_h.first].merge(lvl_h.second);
+			res.all.merge(lvl_h.second);
+		}
+	}
+	return res;
+}
+
+/// Solves all sudokus of the collection and records histograms per level.
+inline BatchHistograms solve_coll_histograms(WorkStealingPool & pool, const sud_coll_t & sud_map,
+	const BatchMode mode = BatchSolve, const SearchLimits & limits = SearchLimits()) {
+	std::vector<raw_sudoku_t> suds(sud_map.size());
+	std::vector<rec_depth_t> lvls(sud_map.size());
+	for (std::size_t i = 0; i < sud_map.size(); ++i) {
+		suds[i] = sud_map.get(i).first;
+		lvls[i] = get_sud_char_level(sud_map.get_desc(i));
+	}
+	std::vector<BatchResult> results(suds.size());
+	return solve_batch_histograms(pool, suds.data(), lvls.data(), suds.size(), results.data(), mode, 2, limits);
+}
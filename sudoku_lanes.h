@@ -0,0 +1,225 @@
+#pragma once
+
+#include "sudoku_batch.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Multi-Sudoku Lanes
+//
+// Propagates naked singles (as \ref find_single_number_cell()) and hidden
+// singles (as \ref find_unique_in_rcs() and \ref find_unique_in_square()) for
+// \ref n_lanes sudokus in lockstep. The candidates are stored as bitmasks in
+// structure-of-arrays form: For every cell, the masks of all lanes are
+// adjacent, so the innermost loops over the lanes compile to SIMD
+// instructions. Sudokus that are not solved by singles continue with the
+// scalar search from the propagated state.
+
+/// Number of sudokus that are propagated together.
+constexpr int n_lanes = 16;
+
+/// State of a lane.
+enum LaneStatus {
+	LaneActive, ///< Propagation still running.
+	LaneSolved, ///< Solved by singles only.
+	LaneInvalid, ///< Contradiction found.
+	LaneStuck, ///< Needs guessing.
+};
+
+/// Up to \ref n_lanes sudokus in structure-of-arrays form.
+struct SudokuLanes {
+	alignas(64) cand_mask_t cand[tot_num_cells][n_lanes]; ///< Candidates per cell and lane.
+	std::array<LaneStatus, n_lanes> status; ///< Status per lane.
+	int n_used; ///< Number of lanes in use.
+};
+
+/// Loads the sudokus 'suds[0, n)', n <= \ref n_lanes, into the lanes.
+///
+/// Unused lanes get all candidates and the status \ref LaneSolved, so
+/// propagation skips them.
+inline void load_lanes(SudokuLanes & lanes, const raw_sudoku_t * suds, const int n) {
+	lanes.n_used = n;
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		for (int l = 0; l < n_lanes; ++l) {
+			const sudoku_value_t v = l < n ? suds[l][c] : 0;
+			lanes.cand[c][l] = v > 0 ? (cand_mask_t)(1 << (v - 1)) : all_cands;
+		}
+	}
+	for (int l = 0; l < n_lanes; ++l) {
+		lanes.status[l] = l < n ? LaneActive : LaneSolved;
+	}
+}
+
+/// Runs naked and hidden singles on all lanes until no lane changes.
+inline void propagate_lanes(SudokuLanes & lanes, const int max_rounds = 4 * tot_num_cells) {
+
+	const SudokuUnits & units = get_units();
+	alignas(64) cand_mask_t placed[3 * side_len][n_lanes];
+	alignas(64) cand_mask_t bad[n_lanes];
+	alignas(64) cand_mask_t changed[n_lanes];
+	std::fill(&bad[0], &bad[0] + n_lanes, (cand_mask_t)0);
+
+	for (int round = 0; round < max_rounds; ++round) {
+		std::fill(&changed[0], &changed[0] + n_lanes, (cand_mask_t)0);
+
+		// Numbers that are set in each unit, detect duplicates
+		for (sudoku_size_t u = 0; u < 3 * side_len; ++u) {
+			alignas(64) cand_mask_t seen[n_lanes] = {};
+			for (sudoku_size_t k = 0; k < side_len; ++k) {
+				const cand_mask_t * c = lanes.cand[units.cells[u][k]];
+				for (int l = 0; l < n_lanes; ++l) {
+					const cand_mask_t single = (c[l] & (c[l] - 1)) == 0 ? c[l] : 0;
+					bad[l] |= seen[l] & single;
+					seen[l] |= single;
+				}
+			}
+			std::copy(&seen[0], &seen[0] + n_lanes, placed[u]);
+		}
+
+		// Naked singles: Remove numbers set in a peer
+		for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+			const auto& u = units.of_cell[c];
+			cand_mask_t * cc = lanes.cand[c];
+			for (int l = 0; l < n_lanes; ++l) {
+				const cand_mask_t old = cc[l];
+				const bool is_single = (old & (old - 1)) == 0;
+				const cand_mask_t peers = placed[u[0]][l] | placed[u[1]][l] | placed[u[2]][l];
+				const cand_mask_t upd = is_single ? old : (cand_mask_t)(old & ~peers);
+				cc[l] = upd;
+				changed[l] |= old ^ upd;
+				bad[l] |= upd == 0 ? 1 : 0;
+			}
+		}
+
+		// Hidden singles: Numbers possible in only one cell of a unit
+		for (sudoku_size_t u = 0; u < 3 * side_len; ++u) {
+			alignas(64) cand_mask_t once[n_lanes] = {};
+			alignas(64) cand_mask_t twice[n_lanes] = {};
+			for (sudoku_size_t k = 0; k < side_len; ++k) {
+				const cand_mask_t * c = lanes.cand[units.cells[u][k]];
+				for (int l = 0; l < n_lanes; ++l) {
+					twice[l] |= once[l] & c[l];
+					once[l] |= c[l];
+				}
+			}
+			for (int l = 0; l < n_lanes; ++l) {
+				bad[l] |= once[l] != all_cands ? 1 : 0;
+				once[l] &= ~twice[l];
+			}
+			for (sudoku_size_t k = 0; k < side_len; ++k) {
+				cand_mask_t * c = lanes.cand[units.cells[u][k]];
+				for (int l = 0; l < n_lanes; ++l) {
+					const cand_mask_t hidden = c[l] & once[l];
+					const cand_mask_t upd = hidden != 0 ? hidden : c[l];
+					bad[l] |= (upd & (upd - 1)) != 0 && hidden != 0 ? 1 : 0;
+					changed[l] |= c[l] ^ upd;
+					c[l] = upd;
+				}
+			}
+		}
+
+		// Retire lanes
+		bool any_active = false;
+		for (int l = 0; l < lanes.n_used; ++l) {
+			if (lanes.status[l] != LaneActive) {
+				continue;
+			}
+			if (bad[l]) {
+				lanes.status[l] = LaneInvalid;
+			}
+			else if (!changed[l]) {
+				lanes.status[l] = LaneStuck;
+			}
+			else {
+				any_active = true;
+			}
+		}
+		if (!any_active) {
+			break;
+		}
+	}
+
+	// Lanes without open cells are solved
+	for (int l = 0; l < lanes.n_used; ++l) {
+		if (lanes.status[l] != LaneStuck && lanes.status[l] != LaneActive) {
+			continue;
+		}
+		bool all_set = true;
+		for (sudoku_size_t c = 0; c < tot_num_cells && all_set; ++c) {
+			all_set = (lanes.cand[c][l] & (lanes.cand[c][l] - 1)) == 0;
+		}
+		lanes.status[l] = all_set ? LaneSolved : LaneStuck;
+	}
+}
+
+/// Converts a lane into the representation of the scalar solver.
+inline sudoku_data_t lane_to_sudoku_data(const SudokuLanes & lanes, const int l) {
+	sudoku_data_t s_data = init_sudoku();
+	for (sudoku_size_t c = 0; c < tot_num_cells; ++c) {
+		const cand_mask_t m = lanes.cand[c][l];
+		if ((m & (m - 1)) == 0) {
+			s_data[c * n_stored_per_cell] = mask_to_number(m);
+		}
+		else {
+			for (sudoku_size_t k = 0; k < side_len; ++k) {
+				s_data[c * n_stored_per_cell + 1 + k] = (m >> k) & 1 ? 2 : 1;
+			}
+		}
+	}
+	return s_data;
+}
+
+/// Solves 'suds[0, n)' in groups of \ref n_lanes and writes 'results[0, n)'.
+///
+/// Equivalent to \ref BatchSolve, lanes that need guessing are solved by
+/// \ref solve_brute_force_multiple() starting from the propagated state,
+/// within the per sudoku 'limits'. Once 'cancel' is cancelled, the remaining
+/// sudokus get the status \ref CancelledSolution.
+inline void solve_lanes(const raw_sudoku_t * suds, const std::size_t n, BatchResult * results,
+	const SearchLimits & limits = SearchLimits(), const CancelToken * cancel = nullptr) {
+	SudokuLanes lanes;
+	for (std::size_t beg = 0; beg < n; beg += n_lanes) {
+		const int n_curr = (int)std::min<std::size_t>(n_lanes, n - beg);
+		const bool cancelled = cancel != nullptr && cancel->is_cancelled();
+		if (!cancelled) {
+			load_lanes(lanes, suds + beg, n_curr);
+			propagate_lanes(lanes);
+		}
+
+		for (int l = 0; l < n_curr; ++l) {
+			BatchResult & res = results[beg + l];
+			res.n_sols = 0;
+			res.lvl = -3;
+			res.n_nodes = 0;
+			if (cancelled) {
+				res.status = CancelledSolution;
+				res.solution = suds[beg + l];
+				continue;
+			}
+			if (lanes.status[l] == LaneInvalid) {
+				res.status = InvalidSolution;
+				res.solution = suds[beg + l];
+				continue;
+			}
+			sudoku_data_t s_data = lane_to_sudoku_data(lanes, l);
+			if (lanes.status[l] == LaneSolved) {
+				res.status = UniqueSolution;
+			}
+			else {
+				SearchBudget budget(limits, cancel);
+				res.status = solve_brute_force_multiple<square_height, square_width>(s_data, &budget);
+				res.n_nodes = budget.n_nodes;
+			}
+			res.solution = get_raw_sudoku(s_data);
+		}
+	}
+}
+
+/// Like \ref solve_batch() with \ref BatchSolve, but propagates in lanes.
+inline void solve_batch_lanes(WorkStealingPool & pool, const raw_sudoku_t * suds, const std::size_t n, BatchResult * results,
+	const SearchLimits & limits = SearchLimits(), const CancelToken * cancel = nullptr) {
+	const std::size_t n_groups = (n + n_lanes - 1) / n_lanes;
+	pool.parallel_for(n_groups, 4, [&](const std::size_t beg, const std::size_t end, const unsigned int) {
+		const std::size_t first = beg * n_lanes;
+		const std::size_t last = std::min(n, end * n_lanes);
+		solve_lanes(suds + first, last - first, results + first, limits, cancel);
+	});
+}
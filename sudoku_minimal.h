@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <atomic>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Minimal Sudokus
+//
+// A sudoku is minimal if it has a unique solution and removing any
+// of its numbers makes the solution ambiguous.
+
+/// Returns the indices of all cells that contain a number.
+inline std::vector<sudoku_size_t> get_clue_cells(const raw_sudoku_t & s) {
+	std::vector<sudoku_size_t> clues;
+	for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+		if (s[i] > 0) {
+			clues.push_back(i);
+		}
+	}
+	return clues;
+}
+
+/// Checks if the sudoku 's' is minimal.
+///
+/// The single-clue-removal uniqueness tests are distributed over 'n_threads'
+/// threads. As soon as one thread finds a redundant clue, the running tests
+/// are cancelled and the remaining ones skipped. Assumes that 's' has a
+/// unique solution. Returns false if 'cancel' is cancelled.
+inline bool is_minimal(const raw_sudoku_t & s, const unsigned int n_threads = default_num_threads(),
+	const CancelToken * cancel = nullptr) {
+
+	const std::vector<sudoku_size_t> clues = get_clue_cells(s);
+	std::atomic<std::size_t> next_clue(0);
+	std::atomic<bool> found_redundant(false);
+	CancelToken stop(cancel);
+
+	auto worker = [&]() {
+		while (!stop.is_cancelled()) {
+			const std::size_t i = next_clue.fetch_add(1, std::memory_order_relaxed);
+			if (i >= clues.size()) {
+				return;
+			}
+			raw_sudoku_t s_removed = s;
+			s_removed[clues[i]] = 0;
+			SearchBudget budget(&stop);
+			if (has_unique_solution(s_removed, &budget)) {
+				found_redundant.store(true, std::memory_order_relaxed);
+				stop.cancel();
+			}
+		}
+	};
+
+	// Run the tests, the calling thread is one of the workers
+	const unsigned int n_workers = std::max(1u, std::min<unsigned int>(n_threads, (unsigned int)clues.size()));
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < n_workers; ++t) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& t : threads) {
+		t.join();
+	}
+	return !found_redundant.load() && !(cancel != nullptr && cancel->is_cancelled());
+}
+
+/// Removes numbers from 's' in random order as long as the solution stays unique.
+///
+/// A number whose removal breaks the uniqueness is kept. Since removing more
+/// numbers can never restore the uniqueness, the result is minimal.
+/// Assumes that 's' has a unique solution.
+template<typename RNG>
+raw_sudoku_t reduce_to_minimal(raw_sudoku_t s, RNG & rng) {
+	std::vector<sudoku_size_t> clues = get_clue_cells(s);
+	std::shuffle(clues.begin(), clues.end(), rng);
+	for (const sudoku_size_t c : clues) {
+		const sudoku_value_t val = s[c];
+		s[c] = 0;
+		if (!has_unique_solution(s)) {
+			s[c] = val;
+		}
+	}
+	return s;
+}
+
+/// Returns a random completely filled sudoku.
+template<typename RNG>
+raw_sudoku_t random_full_sudoku(RNG & rng) {
+	raw_sudoku_t zero_sudoku;
+	std::fill(zero_sudoku.begin(), zero_sudoku.end(), 0);
+	sudoku_data_t sudoku = init_sudoku_with_raw(zero_sudoku);
+	auto_fill(sudoku, true);
+	solve_brute_force_multiple_random<square_height, square_width>(sudoku, rng);
+	return get_raw_sudoku(sudoku);
+}
+
+/// Tries to lower the number of clues of the minimal sudoku 's'.
+///
+/// Repeatedly removes two random clues, adds one cell from the solution 's_sol'
+/// and reduces the result to a minimal sudoku again. Changes that do not
+/// increase the number of clues are accepted, so the search can walk along
+/// plateaus. Returns the sudoku with the fewest clues found.
+template<typename RNG>
+raw_sudoku_t minimize_clue_count(const raw_sudoku_t & s, const raw_sudoku_t & s_sol, RNG & rng, const int n_tries = 200) {
+
+	raw_sudoku_t curr = s;
+	raw_sudoku_t best = s;
+	std::size_t best_n = get_clue_cells(s).size();
+
+	for (int t = 0; t < n_tries; ++t) {
+		std::vector<sudoku_size_t> clues = get_clue_cells(curr);
+		if (clues.size() < 3) {
+			break;
+		}
+
+		// Perturb: -2 / +1
+		raw_sudoku_t cand = curr;
+		std::shuffle(clues.begin(), clues.end(), rng);
+		cand[clues[0]] = 0;
+		cand[clues[1]] = 0;
+		std::vector<sudoku_size_t> empty_cells;
+		for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+			if (cand[i] == 0 && i != clues[0] && i != clues[1]) {
+				empty_cells.push_back(i);
+			}
+		}
+		const sudoku_size_t added = empty_cells[std::uniform_int_distribution<std::size_t>(0, empty_cells.size() - 1)(rng)];
+		cand[added] = s_sol[added];
+		if (!has_unique_solution(cand)) {
+			continue;
+		}
+
+		// Accept if not worse
+		cand = reduce_to_minimal(cand, rng);
+		const std::size_t cand_n = get_clue_cells(cand).size();
+		if (cand_n <= clues.size()) {
+			curr = cand;
+			if (cand_n < best_n) {
+				best = cand;
+				best_n = cand_n;
+			}
+		}
+	}
+	return best;
+}
+
+/// Searches minimal sudokus with at most 'max_clues' numbers.
+///
+/// Every found sudoku is added to 'sud_map' together with its level.
+/// Returns the number of sudokus that were added.
+template<typename RNG>
+num_sud_t generate_minimal_sudokus(sud_coll_t & sud_map, RNG & rng, const sudoku_size_t max_clues = 22,
+	const num_sud_t n_suds = 10, const num_sud_t max_grids = 1000) {
+
+	num_sud_t n_added = 0;
+	for (num_sud_t k = 0; k < max_grids && n_added < n_suds; ++k) {
+
+		// Minimal sudoku from a new random grid
+		const raw_sudoku_t s_sol = random_full_sudoku(rng);
+		raw_sudoku_t s = reduce_to_minimal(s_sol, rng);
+		s = minimize_clue_count(s, s_sol, rng);
+		if ((sudoku_size_t)get_clue_cells(s).size() > max_clues) {
+			continue;
+		}
+
+		// Find level and add
+		sudoku_data_t s_data = init_sudoku_with_raw(s);
+		auto_fill(s_data, true);
+		const rec_depth_t lvl = grade_rec_depth<square_height, square_width>(s_data);
+		const sud_char_t desc = generate_sud_char(s, lvl);
+		if (add_to_coll(sud_map, desc, s, s_sol)) {
+			std::cout << "Added minimal Sudoku, level: " << lvl << ", With ID: " << desc << "\n";
+			++n_added;
+		}
+	}
+	return n_added;
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "Lib.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Portfolio Solving
+//
+// Runs differently configured searches for the same sudoku on separate
+// threads. The first one that finds a definitive answer (unique, multiple
+// or invalid) wins, the others are cancelled. The number of wins of each
+// configuration is recorded, so configurations that never win can be
+// removed from the portfolio.
+
+/// How the cell to guess is chosen.
+enum BranchHeuristic {
+	BranchLeastUncertain, ///< First cell with the least possible numbers, see \ref find_least_uncertain_cell().
+	BranchRandomLeastUncertain, ///< Random cell among those with the least possible numbers.
+	BranchFirstOpen, ///< First empty cell.
+};
+
+/// String array mapping each \ref BranchHeuristic to its name.
+const std::string branch_heuristic_names[] = { "least_uncertain", "random_least_uncertain", "first_open" };
+
+/// Configuration of one search of the portfolio.
+struct SolverConfig {
+	std::string name; ///< Name used in the statistics.
+	bool random_order = false; ///< Try the numbers of a cell in random order.
+	std::uint32_t seed = 42; ///< Seed for the random order and the random branching.
+	BranchHeuristic branching = BranchLeastUncertain; ///< Choice of the cell to guess.
+	PropagationProfile profile; ///< Propagation per search depth.
+};
+
+/// The default portfolio.
+inline std::vector<SolverConfig> default_portfolio() {
+	std::vector<SolverConfig> configs(5);
+	configs[0].name = "deterministic";
+	configs[1].name = "random_order";
+	configs[1].random_order = true;
+	configs[2].name = "random_branching";
+	configs[2].random_order = true;
+	configs[2].seed = 7;
+	configs[2].branching = BranchRandomLeastUncertain;
+	configs[3].name = "singles_only";
+	configs[3].profile = PropagationProfile::singles_below(0);
+	configs[4].name = "chains";
+	configs[4].profile.stages[0].techniques = chain_techniques;
+	return configs;
+}
+
+/// Returns the data index of the cell to guess.
+template<typename RNG>
+sudoku_size_t pick_branch_cell(sudoku_data_t & s_data, const BranchHeuristic branching, RNG & rng) {
+	if (branching == BranchLeastUncertain) {
+		return find_least_uncertain_cell(s_data);
+	}
+
+	sudoku_size_t min_poss_nums = side_len + 1;
+	sudoku_size_t n_ties = 0;
+	sudoku_size_t picked = 0;
+	for (sudoku_size_t cell_ind = 0; cell_ind < tot_num_cells; ++cell_ind) {
+		const sudoku_size_t data_ind = cell_ind * n_stored_per_cell;
+		if (s_data[data_ind] > 0) continue;
+		if (branching == BranchFirstOpen) {
+			return data_ind;
+		}
+		sudoku_size_t num_possible_num = 0;
+		for (sudoku_size_t num = 0; num < side_len; ++num) {
+			num_possible_num += s_data[data_ind + 1 + num] == 2;
+		}
+		if (num_possible_num < min_poss_nums) {
+			min_poss_nums = num_possible_num;
+			n_ties = 1;
+			picked = data_ind;
+		}
+		else if (num_possible_num == min_poss_nums) {
+			// Reservoir sampling among the ties
+			++n_ties;
+			if (std::uniform_int_distribution<sudoku_size_t>(0, n_ties - 1)(rng) == 0) {
+				picked = data_ind;
+			}
+		}
+	}
+	return picked;
+}
+
+// Find a solution and check if it is unique, configured by 'config'
+template<sudoku_size_t square_height, sudoku_size_t square_width, bool printDebugInfo = printRecDebInfo, typename RNG>
+SolveResultFinal solve_configured(sudoku_data_t & s_data, const SolverConfig & config, RNG & rng,
+	SearchBudget * budget = nullptr, const rec_depth_t rec_dep = 0) {
+
+	if (budget && budget->enter_node()) {
+		return budget->stop_result();
+	}
+
+	// Try solving
+	SolveStepRes init_stat = try_solving<printDebugInfo>(s_data, config.profile.at(rec_dep));
+	if (init_stat == Invalid) {
+		return InvalidSolution;
+	}
+	else if (solved<square_height, square_width>(s_data)) {
+		if (budget) ++budget->n_sols;
+		return UniqueSolution;
+	}
+
+	// Solve by guessing recursively
+	sudoku_data_t s_data_copy = s_data;
+	sudoku_data_t s_data_res = s_data;
+	const sudoku_size_t cell_picked = pick_branch_cell(s_data, config.branching, rng);
+	SolveResultFinal res = UnknownSolution;
+	sudoku_size_t num_sols = 0;
+
+	// Random Order
+	std::array<sudoku_value_t, side_len> perm;
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
+		perm[i] = i;
+	}
+	if (config.random_order) {
+		std::shuffle(perm.begin(), perm.end(), rng);
+	}
+
+	// Loop over all possible guesses
+	for (sudoku_size_t i = 0; i < side_len; ++i) {
+
+		const sudoku_size_t curr_i = perm[i];
+
+		if (s_data[cell_picked + 1 + curr_i] == 2) {
+			// Copy data and set guessed value
+			s_data_copy = s_data;
+			s_data_copy[cell_picked] = curr_i + 1;
+
+			// Recursion
+			res = solve_configured<square_height, square_width, printDebugInfo>(s_data_copy, config, rng, budget, rec_dep + 1);
+			if (res == TimeoutSolution || res == CancelledSolution) {
+				return res;
+			}
+			if (res == UniqueSolution) {
+				s_data_res = s_data_copy;
+				num_sols += 1;
+			}
+			if (num_sols > 1 || res == MultipleSolution) {
+				s_data = s_data_copy;
+				return MultipleSolution;
+			}
+		}
+	}
+	s_data = s_data_res;
+	return num_sols == 1 ? UniqueSolution : InvalidSolution;
+}
+
+/// Win statistics of one configuration.
+struct PortfolioStats {
+	std::string name; ///< Name of the configuration.
+	std::uint64_t n_runs = 0; ///< Number of sudokus it ran on.
+	std::uint64_t n_wins = 0; ///< Number of sudokus it answered first.
+	double win_seconds = 0.0; ///< Total time of the won runs.
+};
+
+/// Prints the statistics as one line.
+inline std::ostream& operator<<(std::ostream & os, const PortfolioStats & stats) {
+	os << stats.name << ": " << stats.n_wins << " / " << stats.n_runs << " wins";
+	if (stats.n_wins > 0) {
+		os << ", " << 1000.0 * stats.win_seconds / stats.n_wins << " ms per win";
+	}
+	os << "\n";
+	return os;
+}
+
+/// Result of a portfolio solve.
+struct PortfolioResult {
+	SolveResultFinal status = UnknownSolution; ///< Answer of the winner, timeout or cancelled if there is none.
+	int winner = -1; ///< Index of the winning configuration, -1 if none.
+	double seconds = 0.0; ///< Time until the answer.
+	raw_sudoku_t solution; ///< The solution found by the winner.
+};
+
+/// Races a set of solver configurations against each other.
+class PortfolioSolver {
+
+public:
+	/// Uses one thread per configuration.
+	explicit PortfolioSolver(const std::vector<SolverConfig> & configs = default_portfolio())
+		: configs(configs), stats(configs.size()) {
+		assert(!configs.empty());
+		for (std::size_t k = 0; k < configs.size(); ++k) {
+			stats[k].name = configs[k].name;
+		}
+	}
+
+	/// Solves 's' with all configurations, the first definitive answer wins.
+	///
+	/// The 'limits' apply to each configuration separately. Returns
+	/// \ref TimeoutSolution if all configurations exceeded them and
+	/// \ref CancelledSolution if 'cancel' was cancelled before an answer.
+	PortfolioResult solve(const raw_sudoku_t & s, const SearchLimits & limits = SearchLimits(),
+		const CancelToken * cancel = nullptr) {
+
+		const auto t_start = std::chrono::steady_clock::now();
+		CancelToken race(cancel);
+		std::mutex res_mtx;
+		PortfolioResult res;
+		res.solution = s;
+		bool any_timeout = false;
+
+		auto run = [&](const std::size_t k) {
+			sudoku_data_t s_data = init_sudoku_with_raw(s);
+			auto_fill(s_data, true);
+			std::mt19937 rng(configs[k].seed);
+			SearchBudget budget(limits, &race);
+			const SolveResultFinal status = solve_configured<square_height, square_width>(s_data, configs[k], rng, &budget);
+
+			std::lock_guard<std::mutex> lock(res_mtx);
+			if (status == TimeoutSolution) {
+				any_timeout = true;
+			}
+			if (res.winner >= 0 || status == TimeoutSolution || status == CancelledSolution) {
+				return;
+			}
+			res.winner = (int)k;
+			res.status = status;
+			res.solution = get_raw_sudoku(s_data);
+			res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+			race.cancel();
+		};
+
+		// The calling thread runs the first configuration
+		std::vector<std::thread> threads;
+		for (std::size_t k = 1; k < configs.size(); ++k) {
+			threads.emplace_back(run, k);
+		}
+		run(0);
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		if (res.winner < 0) {
+			res.status = any_timeout ? TimeoutSolution : CancelledSolution;
+			res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+		}
+
+		// Record the statistics
+		std::lock_guard<std::mutex> lock(stats_mtx);
+		for (auto& st : stats) {
+			++st.n_runs;
+		}
+		if (res.winner >= 0) {
+			++stats[res.winner].n_wins;
+			stats[res.winner].win_seconds += res.seconds;
+		}
+		return res;
+	}
+
+	/// Returns the win statistics of all configurations.
+	std::vector<PortfolioStats> get_stats() const {
+		std::lock_guard<std::mutex> lock(stats_mtx);
+		return stats;
+	}
+
+	/// Resets the win statistics.
+	void reset_stats() {
+		std::lock_guard<std::mutex> lock(stats_mtx);
+		for (auto& st : stats) {
+			st = PortfolioStats();
+		}
+		for (std::size_t k = 0; k < configs.size(); ++k) {
+			stats[k].name = configs[k].name;
+		}
+	}
+
+	/// Writes the statistics as CSV with header.
+	void save_stats(std::ostream & os) const {
+		os << "name,runs,wins,win_seconds\n";
+		for (const auto& st : get_stats()) {
+			os << st.name << "," << st.n_runs << "," << st.n_wins << "," << st.win_seconds << "\n";
+		}
+	}
+
+	const std::vector<SolverConfig> & get_configs() const {
+		return configs;
+	}
+
+private:
+	const std::vector<SolverConfig> configs;
+	mutable std::mutex stats_mtx;
+	std::vector<PortfolioStats> stats;
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Lib.h"
+
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Batch Solving of Streams
+//
+// Reads sudokus line by line (see \ref parse_sudoku_line()), solves them on
+// a set of worker threads and writes one line per input line in input order:
+// The solution as digits if it is unique, otherwise "invalid", "multiple"
+// or "parse_error" for lines that could not be read. Empty lines are ignored.
+// Sudokus exceeding the \ref SearchLimits are reported as "timeout".
+
+/// Number of lines that are solved together by one worker.
+constexpr std::size_t stream_batch_size = 256;
+
+/// Statistics of a stream solve.
+struct StreamSolveStats {
+	std::size_t n_lines = 0; ///< Number of processed lines.
+	std::size_t n_unique = 0; ///< Sudokus with unique solution.
+	std::size_t n_multiple = 0; ///< Sudokus with multiple solutions.
+	std::size_t n_invalid = 0; ///< Sudokus without solution.
+	std::size_t n_timeout = 0; ///< Sudokus that exceeded the search limits.
+	std::size_t n_parse_error = 0; ///< Lines that could not be parsed.
+	double seconds = 0.0; ///< Wall time.
+};
+
+/// Prints the statistics including the throughput.
+inline std::ostream& operator<<(std::ostream & os, const StreamSolveStats & stats) {
+	os << "Solved " << stats.n_lines << " lines in " << stats.seconds << " s ("
+		<< (stats.seconds > 0.0 ? stats.n_lines / stats.seconds : 0.0) << " lines/s)\n"
+		<< "Unique: " << stats.n_unique << ", Multiple: " << stats.n_multiple
+		<< ", Invalid: " << stats.n_invalid << ", Timeouts: " << stats.n_timeout
+		<< ", Parse errors: " << stats.n_parse_error << "\n";
+	return os;
+}
+
+/// Solves the sudoku and appends the result line to 'out'.
+inline void solve_to_line(const raw_sudoku_t & s, std::string & out, StreamSolveStats & stats,
+	const SearchLimits & limits = SearchLimits()) {
+	sudoku_data_t s_data = init_sudoku_with_raw(s);
+	auto_fill(s_data, true);
+	SearchBudget budget(limits);
+	const SolveResultFinal res = solve_brute_force_multiple<square_height, square_width>(s_data, &budget);
+	if (res == UniqueSolution) {
+		++stats.n_unique;
+		for (sudoku_size_t i = 0; i < tot_num_cells; ++i) {
+			out += (char)('0' + s_data[i * n_stored_per_cell]);
+		}
+		out += '\n';
+	}
+	else if (res == MultipleSolution) {
+		++stats.n_multiple;
+		out += "multiple\n";
+	}
+	else if (res == TimeoutSolution) {
+		++stats.n_timeout;
+		out += "timeout\n";
+	}
+	else {
+		++stats.n_invalid;
+		out += "invalid\n";
+	}
+}
+
+/// A batch of lines on its way through the pipeline.
+struct StreamBatch {
+	std::uint64_t seq = 0; ///< Position in the input.
+	std::vector<raw_sudoku_t> suds; ///< The parsed sudokus.
+	std::vector<bool> parsed; ///< False for lines that could not be parsed.
+	std::string out; ///< Output lines.
+};
+
+/// Reads sudokus from 'in', solves them with 'n_threads' workers and
+/// writes the results to 'out' in input order.
+///
+/// The searches propagate with 'profile' if given, see \ref ProfileScope.
+inline StreamSolveStats solve_stream(std::istream & in, std::ostream & out, const unsigned int n_threads,
+	const SearchLimits & limits = SearchLimits(), const PropagationProfile * profile = nullptr) {
+
+	const auto t_start = std::chrono::steady_clock::now();
+	const std::size_t max_in_flight = 4 * (std::size_t)std::max(1u, n_threads);
+
+	std::mutex mtx;
+	std::condition_variable work_cv; // Work available or input done
+	std::condition_variable done_cv; // Batch finished
+	std::condition_variable space_cv; // Space in the pipeline
+	std::deque<StreamBatch> work;
+	std::map<std::uint64_t, StreamBatch> finished; // Reorder buffer
+	std::vector<StreamBatch> free_batches;
+	bool input_done = false;
+	std::uint64_t n_in_flight = 0;
+	StreamSolveStats stats;
+
+	// Workers solve whole batches
+	auto worker = [&]() {
+		ProfileScope profile_scope(profile);
+		StreamSolveStats local;
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			work_cv.wait(lock, [&]() { return !work.empty() || input_done; });
+			if (work.empty()) {
+				break;
+			}
+			StreamBatch b = std::move(work.front());
+			work.pop_front();
+			lock.unlock();
+
+			b.out.clear();
+			for (std::size_t i = 0; i < b.suds.size(); ++i) {
+				if (b.parsed[i]) {
+					solve_to_line(b.suds[i], b.out, local, limits);
+				}
+				else {
+					b.out += "parse_error\n";
+				}
+			}
+
+			lock.lock();
+			const std::uint64_t seq = b.seq;
+			finished[seq] = std::move(b);
+			done_cv.notify_one();
+		}
+		stats.n_unique += local.n_unique;
+		stats.n_multiple += local.n_multiple;
+		stats.n_invalid += local.n_invalid;
+		stats.n_timeout += local.n_timeout;
+	};
+
+	// Writer outputs the batches in order
+	std::uint64_t n_batches = 0;
+	bool all_read = false;
+	auto writer = [&]() {
+		std::uint64_t next_seq = 0;
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true) {
+			done_cv.wait(lock, [&]() {
+				return finished.count(next_seq) > 0 || (all_read && next_seq == n_batches);
+			});
+			if (all_read && next_seq == n_batches) {
+				break;
+			}
+			StreamBatch b = std::move(finished[next_seq]);
+			finished.erase(next_seq);
+			lock.unlock();
+			out.write(b.out.data(), (std::streamsize)b.out.size());
+			lock.lock();
+			free_batches.push_back(std::move(b));
+			--n_in_flight;
+			++next_seq;
+			space_cv.notify_one();
+		}
+		out.flush();
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < std::max(1u, n_threads); ++t) {
+		threads.emplace_back(worker);
+	}
+	std::thread writer_thread(writer);
+
+	// Read the input in chunks and cut it into batches
+	StreamBatch curr;
+	auto submit = [&]() {
+		if (curr.suds.empty()) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mtx);
+		space_cv.wait(lock, [&]() { return n_in_flight < max_in_flight; });
+		curr.seq = n_batches++;
+		++n_in_flight;
+		work.push_back(std::move(curr));
+		if (!free_batches.empty()) {
+			curr = std::move(free_batches.back());
+			free_batches.pop_back();
+		}
+		else {
+			curr = StreamBatch();
+		}
+		curr.suds.clear();
+		curr.parsed.clear();
+		lock.unlock();
+		work_cv.notify_one();
+	};
+
+	ParsedSudokuLine line;
+	auto add_line = [&](const char * beg, const char * end) {
+		if (end > beg && end[-1] == '\r') {
+			--end;
+		}
+		if (end == beg) {
+			return;
+		}
+		++stats.n_lines;
+		const bool ok = parse_sudoku_line(beg, end, line);
+		if (!ok) {
+			++stats.n_parse_error;
+		}
+		curr.suds.push_back(line.sud);
+		curr.parsed.push_back(ok);
+		if (curr.suds.size() == stream_batch_size) {
+			submit();
+		}
+	};
+
+	std::vector<char> buf(1 << 20);
+	std::size_t n_buf = 0;
+	while (in) {
+		if (n_buf == buf.size()) {
+			buf.resize(2 * buf.size());
+		}
+		in.read(buf.data() + n_buf, (std::streamsize)(buf.size() - n_buf));
+		n_buf += (std::size_t)in.gcount();
+		const char * p = buf.data();
+		const char * end = buf.data() + n_buf;
+		const char * nl = nullptr;
+		while ((nl = static_cast<const char *>(std::memchr(p, '\n', (std::size_t)(end - p)))) != nullptr) {
+			add_line(p, nl);
+			p = nl + 1;
+		}
+		if (!in) {
+			add_line(p, end);
+			p = end;
+		}
+		n_buf = (std::size_t)(end - p);
+		std::copy(p, end, buf.data());
+	}
+	submit();
+
+	// Shut down
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		input_done = true;
+		all_read = true;
+	}
+	work_cv.notify_all();
+	done_cv.notify_all();
+	for (auto& t : threads) {
+		t.join();
+	}
+	writer_thread.join();
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+	return stats;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "sudoku_portfolio.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Propagation Tuning
+//
+// Picks the \ref PropagationProfile that solves a corpus of sudokus in the
+// least total time. Fewer techniques at deep nodes mean more nodes but less
+// work per node, so the profiles are compared by wall time, not node count.
+
+/// Timing of one profile on a corpus.
+struct ProfileTiming {
+	PropagationProfile profile; ///< The profile.
+	double seconds = 0.0; ///< Best total time over the repetitions.
+	std::uint64_t n_nodes = 0; ///< Total number of search nodes.
+	std::size_t n_timeouts = 0; ///< Sudokus that exceeded the node limit.
+	std::size_t n_mismatches = 0; ///< Sudokus with another result than \ref PropagationProfile::full().
+	std::vector<SolveResultFinal> results; ///< Result per sudoku.
+	std::vector<raw_sudoku_t> solutions; ///< Solution per sudoku, if it is unique.
+};
+
+/// Prints the timing as one line.
+inline std::ostream& operator<<(std::ostream & os, const ProfileTiming & t) {
+	os << t.profile << ": " << t.seconds << " s, " << t.n_nodes << " nodes, " << t.n_timeouts << " timeouts, "
+		<< t.n_mismatches << " mismatches\n";
+	return os;
+}
+
+/// Loads all sudokus of a file, see \ref parse_sudoku_line() for the formats.
+///
+/// Returns an empty corpus if the file could not be read.
+inline std::vector<raw_sudoku_t> load_corpus(const std::string & f_path) {
+	std::vector<raw_sudoku_t> corpus;
+	std::size_t n_invalid = 0;
+	const bool read = parse_sudoku_file(f_path, [&](const ParsedSudokuLine & line) {
+		corpus.push_back(line.sud);
+	}, n_invalid);
+	if (!read) {
+		std::cout << "Could not read " << f_path << "\n";
+		corpus.clear();
+	}
+	else if (n_invalid > 0) {
+		std::cout << "Skipped " << n_invalid << " invalid lines of " << f_path << "\n";
+	}
+	return corpus;
+}
+
+/// The profiles tried by \ref tune_profile().
+///
+/// Full propagation down to depth k, then only singles, a single round of
+/// all techniques or no techniques at all. Additionally the chains at every
+/// depth and down to depth 1.
+inline std::vector<PropagationProfile> candidate_profiles(const int max_k = 4) {
+	PropagationStage singles;
+	singles.techniques = single_techniques;
+	PropagationStage one_round;
+	one_round.max_rounds = 1;
+	PropagationStage none;
+	none.techniques = 0;
+
+	PropagationStage chains;
+	chains.techniques = chain_techniques;
+
+	std::vector<PropagationProfile> profiles = { PropagationProfile::full(),
+		PropagationProfile::split(0, chains, chains), PropagationProfile::split(1, chains, PropagationStage()) };
+	for (int k = 0; k <= max_k && k < max_profile_stages; ++k) {
+		for (const auto& below : { singles, one_round, none }) {
+			profiles.push_back(PropagationProfile::split(k, PropagationStage(), below));
+		}
+	}
+	return profiles;
+}
+
+/// Solves the corpus with the profile and returns the total time and nodes.
+///
+/// Each sudoku is limited to 'max_nodes' nodes, so weak profiles cannot
+/// get stuck on a single hard sudoku.
+inline ProfileTiming time_profile(const std::vector<raw_sudoku_t> & corpus, const PropagationProfile & profile,
+	const int n_repeats = 3, const std::uint64_t max_nodes = 1 << 20) {
+	ProfileTiming res;
+	res.profile = profile;
+	res.seconds = std::numeric_limits<double>::max();
+	SolverConfig config;
+	config.profile = profile;
+	SearchLimits limits;
+	limits.max_nodes = max_nodes;
+
+	for (int rep = 0; rep < std::max(1, n_repeats); ++rep) {
+		std::uint64_t n_nodes = 0;
+		std::size_t n_timeouts = 0;
+		res.results.assign(corpus.size(), UnknownSolution);
+		res.solutions.assign(corpus.size(), raw_sudoku_t());
+		std::mt19937 rng(config.seed);
+		const auto t_start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < corpus.size(); ++i) {
+			sudoku_data_t s_data = init_sudoku_with_raw(corpus[i]);
+			auto_fill(s_data, true);
+			SearchBudget budget(limits);
+			res.results[i] = solve_configured<square_height, square_width>(s_data, config, rng, &budget);
+			if (res.results[i] == TimeoutSolution) {
+				++n_timeouts;
+			}
+			else if (res.results[i] == UniqueSolution) {
+				res.solutions[i] = get_raw_sudoku(s_data);
+			}
+			n_nodes += budget.n_nodes;
+		}
+		const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+		res.seconds = std::min(res.seconds, secs);
+		res.n_nodes = n_nodes;
+		res.n_timeouts = n_timeouts;
+	}
+	return res;
+}
+
+/// Counts the sudokus where 't' has another result or solution than 'ref'.
+inline std::size_t count_mismatches(const ProfileTiming & t, const ProfileTiming & ref) {
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < t.results.size(); ++i) {
+		if (t.results[i] != ref.results[i] || (t.results[i] == UniqueSolution && t.solutions[i] != ref.solutions[i])) {
+			++n;
+		}
+	}
+	return n;
+}
+
+/// Returns the candidate profile with the least total time on the corpus.
+///
+/// Profiles with timeouts or with results that differ from
+/// \ref PropagationProfile::full() are not picked. The timings of all
+/// candidates are written to 'timings' if given. Runs on the calling thread
+/// only, so the timings are not disturbed.
+inline PropagationProfile tune_profile(const std::vector<raw_sudoku_t> & corpus,
+	std::vector<ProfileTiming> * timings = nullptr, const int n_repeats = 3) {
+	PropagationProfile best = PropagationProfile::full();
+	double best_secs = std::numeric_limits<double>::max();
+	const ProfileTiming ref = time_profile(corpus, PropagationProfile::full(), 1);
+	for (const auto& p : candidate_profiles()) {
+		ProfileTiming t = time_profile(corpus, p, n_repeats);
+		t.n_mismatches = count_mismatches(t, ref);
+		if (timings != nullptr) {
+			timings->push_back(t);
+		}
+		if (t.n_timeouts == 0 && t.n_mismatches == 0 && t.seconds < best_secs) {
+			best_secs = t.seconds;
+			best = p;
+		}
+	}
+	return best;
+}